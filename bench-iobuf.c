@@ -0,0 +1,146 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ *
+ * Writes and reads a temporary file with O_DIRECT using buffers from posix_memalign
+ * and from a pre-faulted buddy_alloc_iobuf.h pool. Pass a path on a file system that
+ * supports direct I/O, tmpfs does not.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BUDDY_ALLOC_IMPLEMENTATION
+#define BUDDY_ALLOC_IOBUF_IMPLEMENTATION
+#include "buddy_alloc_iobuf.h"
+#undef BUDDY_ALLOC_IOBUF_IMPLEMENTATION
+#undef BUDDY_ALLOC_IMPLEMENTATION
+
+static const size_t file_size = (size_t) 1 << 26;
+static const size_t min_io = 4096;
+static const size_t max_io = (size_t) 1 << 20;
+static const int rounds = 4;
+
+struct buffers {
+    void *(*get)(void *ctx, size_t size);
+    void (*put)(void *ctx, void *buffer);
+    void *ctx;
+};
+
+static void *memalign_get(void *ctx, size_t size) {
+    void *result = NULL;
+    (void) ctx;
+    if (posix_memalign(&result, 4096, size) != 0) {
+        return NULL;
+    }
+    return result;
+}
+
+static void memalign_put(void *ctx, void *buffer) {
+    (void) ctx;
+    free(buffer);
+}
+
+static void *iobuf_get(void *ctx, size_t size) {
+    return buddy_iobuf_get(ctx, size);
+}
+
+static void iobuf_put(void *ctx, void *buffer) {
+    buddy_iobuf_put(ctx, buffer);
+}
+
+/* Returns the I/O size that follows size, cycling through the powers of two from min_io to max_io */
+static size_t next_io(size_t size) {
+    return (size == max_io) ? min_io : (size * 2);
+}
+
+static unsigned char *get_buffer(const char *name, struct buffers *buffers, size_t size) {
+    unsigned char *buffer = buffers->get(buffers->ctx, size);
+    if (buffer == NULL) {
+        fprintf(stderr, "%s: cannot get a buffer of %zu bytes\n", name, size);
+        exit(1);
+    }
+    return buffer;
+}
+
+/* Writes and reads back the file in I/O sizes that cycle through powers of two */
+static double run(const char *name, int fd, struct buffers *buffers) {
+    size_t offset, size, checksum = 0;
+    unsigned char *buffer;
+    struct timespec start, end;
+    double elapsed;
+    int round;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (round = 0; round < rounds; round++) {
+        for (offset = 0, size = min_io; offset < file_size; offset += size, size = next_io(size)) {
+            if ((offset + size) > file_size) {
+                size = file_size - offset;
+            }
+            buffer = get_buffer(name, buffers, size);
+            memset(buffer, (int) (offset / min_io), size);
+            if (pwrite(fd, buffer, size, (off_t) offset) != (ssize_t) size) {
+                perror("pwrite");
+                exit(1);
+            }
+            buffers->put(buffers->ctx, buffer);
+        }
+        for (offset = 0, size = min_io; offset < file_size; offset += size, size = next_io(size)) {
+            if ((offset + size) > file_size) {
+                size = file_size - offset;
+            }
+            buffer = get_buffer(name, buffers, size);
+            if (pread(fd, buffer, size, (off_t) offset) != (ssize_t) size) {
+                perror("pread");
+                exit(1);
+            }
+            checksum += buffer[size - 1];
+            buffers->put(buffers->ctx, buffer);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (double) (end.tv_sec - start.tv_sec) + ((double) (end.tv_nsec - start.tv_nsec) / 1e9);
+    printf("%-32s %8.3f seconds (checksum %zu)\n", name, elapsed, checksum);
+    return elapsed;
+}
+
+int main(int argc, char **argv) {
+    const char *path = (argc > 1) ? argv[1] : "bench-iobuf.tmp";
+    struct buddy_iobuf_pool *pool;
+    struct buffers memalign_buffers = {memalign_get, memalign_put, NULL};
+    struct buffers iobuf_buffers = {iobuf_get, iobuf_put, NULL};
+    int fd;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, 0600);
+    if ((fd < 0) && (errno == EINVAL)) {
+        printf("O_DIRECT is not supported at %s, using the page cache\n", path);
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    }
+    if (fd < 0) {
+        perror("open");
+        return 1;
+    }
+    unlink(path);
+
+    pool = buddy_iobuf_create(4 * max_io, BUDDY_IOBUF_PREFAULT);
+    if (pool == NULL) {
+        perror("buddy_iobuf_create");
+        return 1;
+    }
+    iobuf_buffers.ctx = pool;
+
+    run("posix_memalign", fd, &memalign_buffers);
+    run("buddy_iobuf_get", fd, &iobuf_buffers);
+
+    buddy_iobuf_destroy(pool);
+    close(fd);
+    return 0;
+}
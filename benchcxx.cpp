@@ -0,0 +1,167 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <vector>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+#define BUDDY_ALLOC_ALIGN 64
+#define BUDDY_ALLOC_IMPLEMENTATION
+#include "buddy_alloc.h"
+#undef BUDDY_ALLOC_IMPLEMENTATION
+
+#include "buddy_alloc.hpp"
+
+static const std::size_t arena_size = std::size_t(1) << 28;
+static const int rounds = 50;
+static const int elements = 20000;
+
+#if defined(__cpp_lib_memory_resource)
+/* Builds and tears down a few node-based and contiguous containers */
+static std::size_t workload(std::pmr::memory_resource *resource) {
+    std::size_t checksum = 0;
+    std::pmr::vector<int> values(resource);
+    std::pmr::list<int> nodes(resource);
+    std::pmr::map<int, int> index(resource);
+    for (int i = 0; i < elements; i++) {
+        values.push_back(i);
+        nodes.push_back(i);
+        index.emplace(i, i);
+    }
+    checksum += values.size() + nodes.size() + index.size();
+    return checksum;
+}
+#endif
+
+/* Fills an arena with small allocations and frees them */
+static double churn(const char *name, struct buddy *allocator, std::size_t size) {
+    static void *slots[std::size_t(1) << 16];
+    std::size_t count, total = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        for (count = 0; count < (sizeof(slots) / sizeof(slots[0])); count++) {
+            slots[count] = buddy_malloc(allocator, 64);
+            if (slots[count] == NULL) {
+                break;
+            }
+        }
+        for (std::size_t j = 0; j < count; j++) {
+            buddy_safe_free(allocator, slots[j], 64);
+        }
+        total += count;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%-32s %8.3f seconds (%zu allocations of a %zu byte arena)\n", name, elapsed.count(), total, size);
+    return elapsed.count();
+}
+
+#if defined(__cpp_lib_memory_resource)
+template <typename Reset>
+static double run(const char *name, std::pmr::memory_resource *resource, Reset reset) {
+    std::size_t checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        checksum += workload(resource);
+        reset();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%-32s %8.3f seconds (checksum %zu)\n", name, elapsed.count(), checksum);
+    return elapsed.count();
+}
+#endif
+
+#if defined(__cpp_impl_coroutine)
+static const int coroutines = 1000000;
+
+struct heap_promise {};
+
+/* A coroutine that runs to completion on its first resumption */
+template <typename Base>
+struct task {
+    struct promise_type : Base {
+        int value = 0;
+        task get_return_object() {
+            return task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(int result) { value = result; }
+        void unhandled_exception() { std::abort(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename Base>
+task<Base> square(int value) {
+    co_return value * value;
+}
+
+/* Creates, runs and destroys short-lived coroutines */
+template <typename Base>
+static double spawn(const char *name) {
+    std::size_t checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < coroutines; i++) {
+        task<Base> coroutine = square<Base>(i & 0xFF);
+        coroutine.handle.resume();
+        checksum += std::size_t(coroutine.handle.promise().value);
+        coroutine.handle.destroy();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%-32s %8.3f seconds (checksum %zu)\n", name, elapsed.count(), checksum);
+    return elapsed.count();
+}
+#endif
+
+int main() {
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    /*
+     * The tree order and the alignment of the arena reach the tree code as constants only
+     * with the static configuration, see `make benchcxx-static`
+     */
+    static buddy_alloc::arena<17, 64> fixed;
+    churn("buddy_alloc::arena<17, 64>", fixed.get(), fixed.size);
+#ifndef BUDDY_STATIC_ORDER
+    unsigned char *buddy_buf = static_cast<unsigned char *>(std::malloc(buddy_sizeof(arena_size)));
+    unsigned char *data_buf = static_cast<unsigned char *>(std::malloc(arena_size));
+
+    /* The same arena size with the allocator set up at run time */
+    struct buddy *runtime = buddy_init_alignment(buddy_buf, data_buf, fixed.size, 64);
+    churn("buddy_init_alignment", runtime, fixed.size);
+
+#if defined(__cpp_lib_memory_resource)
+    struct buddy *allocator = buddy_init(buddy_buf, data_buf, arena_size);
+    buddy_alloc::memory_resource buddy_resource(allocator);
+    run("buddy_alloc::memory_resource", &buddy_resource, [] {});
+
+    std::pmr::monotonic_buffer_resource monotonic(data_buf, arena_size, std::pmr::null_memory_resource());
+    run("monotonic_buffer_resource", &monotonic, [&monotonic] { monotonic.release(); });
+
+    std::pmr::unsynchronized_pool_resource pool;
+    run("unsynchronized_pool_resource", &pool, [] {});
+
+    run("new_delete_resource", std::pmr::new_delete_resource(), [] {});
+#endif
+
+#if defined(__cpp_impl_coroutine)
+    /* Coroutine frames from the heap and from a thread-bound arena */
+    spawn<heap_promise>("coroutines with operator new");
+    {
+        buddy_alloc::coroutine_allocator scope(buddy_init(buddy_buf, data_buf, 1 << 16));
+        spawn<buddy_alloc::promise_base>("buddy_alloc::promise_base");
+    }
+#endif
+
+    std::free(data_buf);
+    std::free(buddy_buf);
+#endif
+}
@@ -27,6 +27,58 @@
 #endif
 #endif
 
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+/* Maximum number of freed slots that are kept pending release */
+#ifndef BUDDY_DEFERRED_FREE_SLOTS
+#define BUDDY_DEFERRED_FREE_SLOTS 8
+#endif
+#if BUDDY_DEFERRED_FREE_SLOTS > UCHAR_MAX
+#error BUDDY_DEFERRED_FREE_SLOTS must fit in an unsigned char
+#endif
+#endif /* BUDDY_EXPERIMENTAL_DEFERRED_FREE */
+
+#ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
+/* Maximum number of changed ranges that are reported at once */
+#ifndef BUDDY_CHANGE_TRACKING_RANGES
+#define BUDDY_CHANGE_TRACKING_RANGES 8
+#endif
+#endif /* BUDDY_EXPERIMENTAL_CHANGE_TRACKING */
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+/* Maximum number of tentative blocks that are not yet published */
+#ifndef BUDDY_TENTATIVE_SLOTS
+#define BUDDY_TENTATIVE_SLOTS 8
+#endif
+#endif /* BUDDY_EXPERIMENTAL_TWO_PHASE */
+
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+/* Granularity of the dirty page tracking */
+#ifndef BUDDY_DIRTY_PAGE_SIZE
+#define BUDDY_DIRTY_PAGE_SIZE 4096
+#endif
+#if (BUDDY_DIRTY_PAGE_SIZE & (BUDDY_DIRTY_PAGE_SIZE - 1)) != 0
+#error BUDDY_DIRTY_PAGE_SIZE must be a power of two
+#endif
+#endif /* BUDDY_EXPERIMENTAL_DIRTY_PAGES */
+
+/*
+ * Static configuration. Defining BUDDY_STATIC_ORDER and/or BUDDY_STATIC_ALIGNMENT fixes the
+ * tree order and/or the alignment of every allocator in the program so that the allocation
+ * paths work with constants. Arenas that need a different tree order or alignment are
+ * rejected by buddy_sizeof_alignment, by the init and embed functions and by buddy_resize.
+ * Use BUDDY_METADATA_SIZE to size the metadata in static storage.
+ */
+#ifdef BUDDY_STATIC_ORDER
+#if BUDDY_STATIC_ORDER < 1
+#error BUDDY_STATIC_ORDER must be positive
+#endif
+#endif /* BUDDY_STATIC_ORDER */
+#ifdef BUDDY_STATIC_ALIGNMENT
+#if (BUDDY_STATIC_ALIGNMENT < 1) || ((BUDDY_STATIC_ALIGNMENT & (BUDDY_STATIC_ALIGNMENT - 1)) != 0)
+#error BUDDY_STATIC_ALIGNMENT must be a power of two
+#endif
+#endif /* BUDDY_STATIC_ALIGNMENT */
+
 #ifdef __cplusplus
 #ifndef BUDDY_CPP_MANGLED
 extern "C" {
@@ -44,12 +96,72 @@ size_t buddy_sizeof(size_t memory_size);
  */
 size_t buddy_sizeof_alignment(size_t memory_size, size_t alignment);
 
+/*
+ * The size of a buddy for a tree of the specified order using the specified alignment, as a
+ * constant expression that can size static storage. A tree of order N manages an arena of up to
+ * alignment * 2^(N-1) bytes and the result matches buddy_sizeof_alignment for that arena size.
+ */
+#define BUDDY_METADATA_SIZE(order, alignment) \
+    (BUDDY_METADATA_HEADER_SIZE + BUDDY_METADATA_TREE_SIZE(order) \
+        + BUDDY_METADATA_ZERO_BITS_SIZE(order) + BUDDY_METADATA_DIRTY_BITS_SIZE(order, alignment))
+
+/* The parts of BUDDY_METADATA_SIZE, these follow the metadata layout of the implementation */
+#define BUDDY_METADATA_BYTES(bits) (((bits) + CHAR_BIT - 1) / CHAR_BIT)
+#define BUDDY_METADATA_TREE_BITS(order) (((size_t)1 << ((order) + 1)) - (order) - 2)
+#define BUDDY_METADATA_TREE_SIZE(order) \
+    (3 * sizeof(size_t) /* tree header */ \
+        + BUDDY_METADATA_BYTES(BUDDY_METADATA_TREE_BITS(order)) \
+        + (BUDDY_METADATA_BYTES(BUDDY_METADATA_TREE_BITS(order)) % sizeof(size_t)) \
+        + ((order) + 2) * sizeof(size_t) /* size_for_order memoization */)
+#define BUDDY_METADATA_HEADER_SIZE \
+    (3 * sizeof(size_t) + sizeof(ptrdiff_t) + BUDDY_METADATA_DEFERRED_SIZE \
+        + BUDDY_METADATA_TENTATIVE_SIZE + BUDDY_METADATA_LOG_SIZE)
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+#define BUDDY_METADATA_DEFERRED_SIZE \
+    (sizeof(size_t) * (1 + BUDDY_DEFERRED_FREE_SLOTS) \
+        + sizeof(size_t) * ((BUDDY_DEFERRED_FREE_SLOTS + sizeof(size_t) * CHAR_BIT + sizeof(size_t)) / sizeof(size_t)))
+#else
+#define BUDDY_METADATA_DEFERRED_SIZE 0
+#endif
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+#define BUDDY_METADATA_TENTATIVE_SIZE (sizeof(size_t) * BUDDY_TENTATIVE_SLOTS)
+#else
+#define BUDDY_METADATA_TENTATIVE_SIZE 0
+#endif
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+#define BUDDY_METADATA_LOG_SIZE sizeof(void *)
+#else
+#define BUDDY_METADATA_LOG_SIZE 0
+#endif
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+#define BUDDY_METADATA_ZERO_BITS_SIZE(order) BUDDY_METADATA_BYTES((size_t)1 << ((order) - 1))
+#else
+#define BUDDY_METADATA_ZERO_BITS_SIZE(order) 0
+#endif
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+#define BUDDY_METADATA_DIRTY_BITS_SIZE(order, alignment) \
+    BUDDY_METADATA_BYTES((((size_t)1 << ((order) - 1)) * (alignment) + BUDDY_DIRTY_PAGE_SIZE - 1) \
+        / BUDDY_DIRTY_PAGE_SIZE)
+#else
+#define BUDDY_METADATA_DIRTY_BITS_SIZE(order, alignment) 0
+#endif
+
 /* Initializes a binary buddy memory allocator at the specified location */
 struct buddy *buddy_init(unsigned char *at, unsigned char *main, size_t memory_size);
 
 /* Initializes a binary buddy memory allocator at the specified location using a non-default alignment */
 struct buddy *buddy_init_alignment(unsigned char *at, unsigned char *main, size_t memory_size, size_t alignment);
 
+/*
+ * Stores the arena of an allocator that is external to its arena as an offset from the
+ * allocator instead of as an absolute address, as in embedded mode.
+ *
+ * The allocator and its arena can then be placed in a shared or persistent mapping that is
+ * mapped at different addresses by different processes. Both must be in the same mapping
+ * so that the distance between them is preserved. Has no effect on an embedded allocator.
+ */
+void buddy_enable_relative_mode(struct buddy *buddy);
+
 /*
  * Initializes a binary buddy memory allocator embedded in the specified arena.
  * The arena's capacity is reduced to account for the allocator metadata.
@@ -75,6 +187,20 @@ struct buddy *buddy_embed_alignment(unsigned char *main, size_t memory_size, siz
  */
 struct buddy *buddy_get_embed_at_alignment(unsigned char *main, size_t memory_size, size_t alignment);
 
+/*
+ * Copies the allocator state to a new location and binds the copy to the new_main arena.
+ * Use together with a copy of the arena contents to make a speculative copy of an arena
+ * that can be kept or discarded without affecting the source.
+ *
+ * For an allocator that is external to the arena the copy is placed at the specified location,
+ * which must have room for buddy_sizeof_alignment bytes for the same arena size and alignment.
+ * For an embedded allocator the at parameter is ignored and the copy is placed in new_main where
+ * buddy_get_embed_at will find it.
+ *
+ * Returns NULL on failure.
+ */
+struct buddy *buddy_clone(unsigned char *at, struct buddy *buddy, unsigned char *new_main);
+
 /* 
  * Resizes the arena and allocator metadata to a new size.
  *
@@ -124,6 +250,14 @@ void *buddy_realloc(struct buddy *buddy, void *ptr, size_t requested_size, bool
 void *buddy_reallocarray(struct buddy *buddy, void *ptr,
     size_t members_count, size_t member_size, bool ignore_data);
 
+/*
+ * Grows or shrinks an allocation without moving it. Returns true if the allocation
+ * now holds the requested size at the same address. Growing needs the adjacent space
+ * to be free and fails if the larger slot would start elsewhere. The allocation is
+ * left unchanged on failure.
+ */
+bool buddy_realloc_in_place(struct buddy *buddy, void *ptr, size_t requested_size);
+
 /* Use the specified buddy to free memory. See free. */
 void buddy_free(struct buddy *buddy, void *ptr);
 
@@ -138,6 +272,31 @@ enum buddy_safe_free_status {
 /* A (safer) free with a size. Will not free unless the size fits the target span. */
 enum buddy_safe_free_status buddy_safe_free(struct buddy *buddy, void *ptr, size_t requested_size);
 
+/*
+ * Returns the size of the slot that holds an allocation, which can be larger than
+ * the requested size. See malloc_usable_size. Returns zero if there is no allocation
+ * at the specified address.
+ */
+size_t buddy_usable_size(struct buddy *buddy, void *ptr);
+
+/* A part of a scattered allocation. Has the layout of struct iovec on POSIX systems. */
+struct buddy_segment {
+    void *base;
+    size_t length;
+};
+
+/*
+ * Allocates the requested size in up to max_segments parts when there is no single
+ * free slot large enough for it. Parts are taken from the largest free slots first.
+ * Returns the number of segments written or zero on failure, in which case nothing
+ * is allocated. Use buddy_free_sg to free the segments.
+ */
+size_t buddy_malloc_sg(struct buddy *buddy, size_t requested_size,
+    struct buddy_segment *segments, size_t max_segments);
+
+/* Frees the segments of a scattered allocation. */
+void buddy_free_sg(struct buddy *buddy, struct buddy_segment *segments, size_t count);
+
 /*
  * Reservation functions
  */
@@ -172,12 +331,51 @@ void *buddy_walk(struct buddy *buddy, void *(fp)(void *ctx, void *addr, size_t s
  */
 unsigned char buddy_fragmentation(struct buddy *buddy);
 
+/*
+ * Rebuilds the allocator tree after its metadata was left partially updated,
+ * e.g. by a crash while the metadata was mapped from a file.
+ *
+ * The tree is rebuilt from the allocated slots upwards. An operation that was
+ * interrupted is either completed or undone, except that an interrupted free
+ * may leave its slot allocated. Slots that are pending a deferred free are kept
+ * allocated, all known-zero state is dropped and all pages are marked dirty.
+ */
+void buddy_recover(struct buddy *buddy);
+
+/*
+ * Writes a compact snapshot of the allocator state and returns its size in bytes.
+ *
+ * The snapshot lists the allocated slots and reserved ranges in address order,
+ * so its size depends on the number of allocations and not on the arena size.
+ * Nothing is written past the capacity - if the result is larger than it the
+ * snapshot is incomplete. Call with a zero capacity to get the required size.
+ */
+size_t buddy_serialize(struct buddy *buddy, unsigned char *out, size_t capacity);
+
+/*
+ * Replaces the allocator state with a snapshot written by buddy_serialize.
+ *
+ * The allocator must have the same arena size and alignment as the serialized one.
+ * It can be in either mode and at another address. The tree is rebuilt in a single pass.
+ * Returns false and leaves the allocator unchanged if the snapshot does not fit it.
+ */
+bool buddy_deserialize(struct buddy *buddy, const unsigned char *in, size_t length);
+
 #ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
+/* A range of allocator metadata that was changed */
+struct buddy_change_range {
+    unsigned char *addr;
+    size_t length;
+};
+
 /*
  * Enable change tracking for this allocator instance.
  *
  * This will store a header at the start of the arena that contains the function pointer (tracker) and
- * a void* (context). The tracker will be called with the context, the start of changed memory and its length.
+ * a void* (context). The tracker will be called once per operation that changes the allocation tree
+ * with the context and the changed ranges of memory. The ranges are disjoint, sorted by address and
+ * there are at most BUDDY_CHANGE_TRACKING_RANGES of them - nearby changes are merged to fit.
+ * Releasing the slots that are pending a deferred free is reported separately.
  *
  * This function MUST be called before any allocations are performed!
  *
@@ -187,7 +385,132 @@ unsigned char buddy_fragmentation(struct buddy *buddy);
  *
  * The API is not (yet) part of the allocator contract and its semantic versioning!
  */
-void buddy_enable_change_tracking(struct buddy* buddy, void* context, void (*tracker) (void*, unsigned char*, size_t));
+void buddy_enable_change_tracking(struct buddy* buddy, void* context,
+    void (*tracker) (void*, struct buddy_change_range*, size_t));
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+/*
+ * Enable deferred free for this allocator instance.
+ *
+ * Freed slots are kept allocated in a small buffer instead of being released right away.
+ * The buffer keeps a LIFO list per slot size and an allocation of the same size takes
+ * the most recently freed slot in constant time, without searching the tree.
+ * The buffer is released in a single batch when it fills up, when an allocation cannot be
+ * satisfied and before any function that inspects or changes the allocator state otherwise.
+ *
+ * The buffer size is set with BUDDY_DEFERRED_FREE_SLOTS.
+ *
+ * The API is not (yet) part of the allocator contract and its semantic versioning!
+ */
+void buddy_enable_deferred_free(struct buddy *buddy);
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+/*
+ * Records that the memory in the indicated range reads as zero.
+ *
+ * The allocator keeps a known-zero bit per alignment-sized block and buddy_calloc
+ * only clears the blocks of a slot that are not known to be zero. The bits start
+ * cleared, are cleared when a slot is handed out or reserved and are set by this
+ * function for the blocks that lie entirely within the range.
+ *
+ * Call it for memory that is not allocated - e.g. over the whole arena right after
+ * initializing the allocator on freshly mapped memory, or for a freed slot after
+ * returning its pages to the system with MADV_DONTNEED.
+ *
+ * The API is not (yet) part of the allocator contract and its semantic versioning!
+ */
+void buddy_mark_zeroed(struct buddy *buddy, void *ptr, size_t requested_size);
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+/*
+ * Allocates a tentative block for a persistent heap.
+ *
+ * The block is allocated as with buddy_malloc and recorded in a small table in
+ * the allocator metadata. buddy_recover releases the recorded blocks, so a crash
+ * before buddy_publish does not leak the block. Freeing the block drops it from
+ * the table.
+ *
+ * Returns NULL when the allocation fails or the table is full.
+ * The table size is set with BUDDY_TENTATIVE_SLOTS.
+ *
+ * The API is not (yet) part of the allocator contract and its semantic versioning!
+ */
+void *buddy_reserve(struct buddy *buddy, size_t requested_size);
+
+/*
+ * Makes a tentative block a regular allocation.
+ * This is a single word write to the allocator metadata.
+ */
+void buddy_publish(struct buddy *buddy, void *ptr);
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+/*
+ * Marks the arena pages that overlap the indicated range as dirty.
+ *
+ * The allocator keeps a dirty bit per BUDDY_DIRTY_PAGE_SIZE page of the arena.
+ * Pages are marked when buddy_malloc, buddy_calloc and buddy_realloc hand out
+ * a slot. Writes to memory that was handed out earlier are not seen by the
+ * allocator - mark them with this function.
+ *
+ * The API is not (yet) part of the allocator contract and its semantic versioning!
+ */
+void buddy_mark_dirty(struct buddy *buddy, void *ptr, size_t requested_size);
+
+/* Clears all dirty pages, starting a new checkpoint epoch. */
+void buddy_checkpoint(struct buddy *buddy);
+
+/*
+ * Iterate through the runs of pages that are dirty and still allocated and call
+ * the provided function for each run. Dirty pages that were freed since are skipped.
+ *
+ * If the provided function returns a non-NULL result the iteration stops and the result
+ * is returned to called. NULL is returned upon completing iteration without stopping.
+ */
+void *buddy_walk_dirty(struct buddy *buddy, void *(fp)(void *ctx, void *addr, size_t length), void *ctx);
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+/*
+ * A ring buffer of allocator operation records, owned by the caller.
+ *
+ * The allocator appends records at head and the caller consumes them from tail.
+ * Both are byte counters that only grow, a byte is stored at counter % capacity.
+ * Records that do not fit are dropped and counted - a replica needs to be
+ * brought back in sync with buddy_serialize after that.
+ */
+struct buddy_log {
+    unsigned char *buffer;
+    size_t capacity;
+    size_t head;
+    size_t tail;
+    size_t dropped;
+};
+
+/*
+ * Enable the operation log for this allocator instance, or disable it with a NULL log.
+ *
+ * Every change of the allocated slots - by malloc, calloc, realloc, free, reserving
+ * and releasing ranges, releasing deferred frees and resizing - appends a record
+ * of a few bytes. buddy_recover and buddy_deserialize are not logged.
+ *
+ * The API is not (yet) part of the allocator contract and its semantic versioning!
+ */
+void buddy_enable_log(struct buddy *buddy, struct buddy_log *log);
+
+/*
+ * Replays log records on a replica that is in the same state as the logging allocator was
+ * when the first record was appended. The replica reaches the same tree and hands out
+ * the same slots from then on.
+ *
+ * Replay stops at the first incomplete or invalid record. The number of bytes that were
+ * applied is stored in applied. Returns the replica, which a resize of an embedded
+ * allocator moves, as with buddy_resize.
+ */
+struct buddy *buddy_apply_log(struct buddy *buddy, const unsigned char *in, size_t length, size_t *applied);
 #endif
 
 #ifdef __cplusplus
@@ -208,8 +531,12 @@ extern "C" {
 #endif
 
 #ifndef BUDDY_ALLOC_ALIGN
+#ifdef BUDDY_STATIC_ALIGNMENT
+#define BUDDY_ALLOC_ALIGN BUDDY_STATIC_ALIGNMENT
+#else
 #define BUDDY_ALLOC_ALIGN (sizeof(size_t) * CHAR_BIT)
 #endif
+#endif
 
 #ifdef __cplusplus
 #ifndef BUDDY_ALIGNOF
@@ -260,10 +587,14 @@ typedef signed long ssize_t;
 /* Implementation defined */
 void buddy_debug(struct buddy *buddy);
 
+#ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
 struct buddy_change_tracker {
     void* context;
-    void (*tracker) (void*, unsigned char*, size_t);
+    void (*tracker) (void*, struct buddy_change_range*, size_t);
+    size_t range_count;
+    struct buddy_change_range ranges[BUDDY_CHANGE_TRACKING_RANGES]; /* pending until committed */
 };
+#endif /* BUDDY_EXPERIMENTAL_CHANGE_TRACKING */
 
 struct buddy_tree;
 
@@ -317,6 +648,12 @@ static void buddy_tree_resize(struct buddy_tree *t, uint8_t desired_order);
 static void buddy_tree_enable_change_tracking(struct buddy_tree *t);
 #endif /* BUDDY_EXPERIMENTAL_CHANGE_TRACKING */
 
+/* Reports the changes made to the tree since the last commit to the change tracker, if any */
+static void buddy_tree_commit_changes(struct buddy_tree *t);
+
+/* Drops the changes made to the tree since the last commit without reporting them */
+static void buddy_tree_discard_changes(struct buddy_tree *t);
+
 /*
  * Navigation functions
  */
@@ -380,6 +717,25 @@ enum buddy_tree_release_status {
 /* Marks the indicated position as free and propagates the change */
 static enum buddy_tree_release_status buddy_tree_release(struct buddy_tree *t, struct buddy_tree_pos pos);
 
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+/* Marks the indicated allocated positions as free, propagating once through shared ancestors */
+static void buddy_tree_release_batch(struct buddy_tree *t, const size_t *indices, size_t count);
+#endif /* BUDDY_EXPERIMENTAL_DEFERRED_FREE */
+
+/* Recomputes the inner nodes from their children, keeping nodes that are allocated in full */
+static void buddy_tree_rebuild(struct buddy_tree *t);
+
+/* Marks all positions as free */
+static void buddy_tree_clear(struct buddy_tree *t);
+
+/* Marks the indicated position as allocated without propagating the change, see buddy_tree_rebuild */
+static void buddy_tree_mark_unlinked(struct buddy_tree *t, struct buddy_tree_pos pos);
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+/* Returns the index that a position in the left subtree has after resizing to another order */
+static size_t buddy_tree_index_for_order(size_t index, size_t from_order, size_t to_order);
+#endif /* BUDDY_EXPERIMENTAL_TWO_PHASE */
+
 /* Returns a free position at the specified depth or an invalid position */
 static struct buddy_tree_pos buddy_tree_find_free(struct buddy_tree *t, uint8_t depth);
 
@@ -476,6 +832,19 @@ static inline size_t integer_square_root(size_t f);
 */
 
 const unsigned int BUDDY_RELATIVE_MODE = 1;
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+const unsigned int BUDDY_DEFERRED_FREE_MODE = 2;
+#endif
+/* Set together with BUDDY_RELATIVE_MODE when the allocator is external to its arena */
+const unsigned int BUDDY_EXTERNAL_MODE = 4;
+
+enum buddy_log_op {
+    BUDDY_LOG_MARK = 1,         /* tree position index */
+    BUDDY_LOG_RELEASE = 2,      /* tree position index */
+    BUDDY_LOG_RESERVE = 3,      /* arena offset and size */
+    BUDDY_LOG_UNRESERVE = 4,    /* arena offset and size */
+    BUDDY_LOG_RESIZE = 5        /* new memory size */
+};
 
 /*
  * A binary buddy memory allocator
@@ -489,6 +858,20 @@ struct buddy {
         ptrdiff_t main_offset;
     } arena;
     size_t buddy_flags;
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+    size_t deferred_count;
+    size_t deferred[BUDDY_DEFERRED_FREE_SLOTS]; /* tree position indices */
+    /* Slot links are one-based, zero terminates a list */
+    unsigned char deferred_next[BUDDY_DEFERRED_FREE_SLOTS];
+    unsigned char deferred_top[sizeof(size_t) * CHAR_BIT]; /* a LIFO list per tree depth */
+    unsigned char deferred_unused;
+#endif
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+    size_t tentative[BUDDY_TENTATIVE_SLOTS]; /* tree position indices, zero if unused */
+#endif
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+    struct buddy_log *log;
+#endif
 };
 
 struct buddy_embed_check {
@@ -501,10 +884,12 @@ static unsigned int is_valid_alignment(size_t alignment);
 static size_t buddy_tree_order_for_memory(size_t memory_size, size_t alignment);
 static size_t depth_for_size(struct buddy *buddy, size_t requested_size);
 static inline size_t size_for_depth(struct buddy *buddy, size_t depth);
+static inline size_t buddy_alignment(struct buddy *buddy);
 static unsigned char *address_for_position(struct buddy *buddy, struct buddy_tree_pos pos);
 static struct buddy_tree_pos position_for_address(struct buddy *buddy, const unsigned char *addr);
 static unsigned char *buddy_main(struct buddy *buddy);
 static unsigned int buddy_relative_mode(struct buddy *buddy);
+static unsigned int buddy_embedded_mode(struct buddy *buddy);
 static struct buddy_tree *buddy_tree(struct buddy *buddy);
 static size_t buddy_effective_memory_size(struct buddy *buddy);
 static size_t buddy_virtual_slots(struct buddy *buddy);
@@ -515,13 +900,44 @@ static struct buddy *buddy_resize_embedded(struct buddy *buddy, size_t new_memor
 static bool buddy_is_free(struct buddy *buddy, size_t from);
 static struct buddy_embed_check buddy_embed_offset(size_t memory_size, size_t alignment);
 static struct buddy_tree_pos deepest_position_for_offset(struct buddy *buddy, size_t offset);
+static void buddy_deferred_free_flush(struct buddy *buddy);
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+static void buddy_deferred_free_reset(struct buddy *buddy);
+static void buddy_deferred_free_push(struct buddy *buddy, struct buddy_tree_pos pos);
+static struct buddy_tree_pos buddy_deferred_free_take(struct buddy *buddy, size_t depth);
+#endif /* BUDDY_EXPERIMENTAL_DEFERRED_FREE */
+static void *buddy_allocate(struct buddy *buddy, size_t requested_size, size_t zeroed_size);
+static size_t buddy_varint_put(unsigned char *out, size_t capacity, size_t at, size_t value);
+static bool buddy_varint_get(const unsigned char *in, size_t length, size_t *at, size_t *value);
+static bool buddy_deserialize_slots(struct buddy *buddy, const unsigned char *in, size_t length,
+    size_t at, bool apply);
+static unsigned char *buddy_slot_address(struct buddy *buddy, struct buddy_tree_pos pos, size_t zeroed_size);
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+static size_t buddy_zero_bits_sizeof(size_t tree_order);
+static unsigned char *buddy_zero_bits(struct buddy *buddy, size_t tree_order);
+static void buddy_zero_bits_move(struct buddy *buddy, size_t from_order, size_t to_order);
+#endif /* BUDDY_EXPERIMENTAL_ZERO_TRACKING */
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+static size_t *buddy_tentative_entry(struct buddy *buddy, size_t index);
+static void buddy_tentative_forget(struct buddy *buddy, size_t index);
+#endif /* BUDDY_EXPERIMENTAL_TWO_PHASE */
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+static size_t buddy_dirty_pages(size_t tree_order, size_t alignment);
+static unsigned char *buddy_dirty_bits(struct buddy *buddy, size_t tree_order);
+static void buddy_dirty_bits_move(struct buddy *buddy, size_t from_order, size_t to_order);
+static void buddy_dirty_mark(struct buddy *buddy, size_t offset, size_t length);
+#endif /* BUDDY_EXPERIMENTAL_DIRTY_PAGES */
+static void buddy_log_append(struct buddy *buddy, unsigned int op, size_t first, size_t second);
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+static bool buddy_log_replay(struct buddy **buddy, unsigned int op, size_t first, size_t second);
+#endif /* BUDDY_EXPERIMENTAL_OP_LOG */
 
 size_t buddy_sizeof(size_t memory_size) {
     return buddy_sizeof_alignment(memory_size, BUDDY_ALLOC_ALIGN);
 }
 
 size_t buddy_sizeof_alignment(size_t memory_size, size_t alignment) {
-    size_t buddy_tree_order;
+    size_t buddy_tree_order, buddy_size;
 
     if (!is_valid_alignment(alignment)) {
         return 0; /* invalid */
@@ -530,7 +946,21 @@ size_t buddy_sizeof_alignment(size_t memory_size, size_t alignment) {
         return 0; /* invalid */
     }
     buddy_tree_order = buddy_tree_order_for_memory(memory_size, alignment);
-    return sizeof(struct buddy) + buddy_tree_sizeof((uint8_t)buddy_tree_order);
+#ifdef BUDDY_STATIC_ORDER
+    if (buddy_tree_order != BUDDY_STATIC_ORDER) {
+        return 0; /* invalid, the tree order is fixed */
+    }
+#endif
+    buddy_size = sizeof(struct buddy) + buddy_tree_sizeof((uint8_t)buddy_tree_order);
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    /* Account for the known-zero bits stored after the tree */
+    buddy_size += buddy_zero_bits_sizeof(buddy_tree_order);
+#endif
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+    /* Account for the dirty page bits stored after them */
+    buddy_size += bitset_sizeof(buddy_dirty_pages(buddy_tree_order, alignment));
+#endif
+    return buddy_size;
 }
 
 struct buddy *buddy_init(unsigned char *at, unsigned char *main, size_t memory_size) {
@@ -578,11 +1008,35 @@ struct buddy *buddy_init_alignment(unsigned char *at, unsigned char *main, size_
     buddy->memory_size = memory_size;
     buddy->buddy_flags = 0;
     buddy->alignment = alignment;
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+    buddy_deferred_free_reset(buddy);
+#endif
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+    memset(buddy->tentative, 0, sizeof(buddy->tentative));
+#endif
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+    buddy->log = NULL;
+#endif
     buddy_tree_init((unsigned char *)buddy + sizeof(*buddy), (uint8_t) buddy_tree_order);
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    memset(buddy_zero_bits(buddy, buddy_tree_order), 0, buddy_zero_bits_sizeof(buddy_tree_order));
+#endif
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+    memset(buddy_dirty_bits(buddy, buddy_tree_order), 0,
+        bitset_sizeof(buddy_dirty_pages(buddy_tree_order, alignment)));
+#endif
     buddy_toggle_virtual_slots(buddy, 1);
     return buddy;
 }
 
+void buddy_enable_relative_mode(struct buddy *buddy) {
+    if ((buddy == NULL) || buddy_relative_mode(buddy)) {
+        return;
+    }
+    buddy->arena.main_offset = (unsigned char *)buddy - buddy->arena.main;
+    buddy->buddy_flags |= BUDDY_RELATIVE_MODE | BUDDY_EXTERNAL_MODE;
+}
+
 struct buddy *buddy_embed(unsigned char *main, size_t memory_size) {
     return buddy_embed_alignment(main, memory_size, BUDDY_ALLOC_ALIGN);
 }
@@ -624,26 +1078,81 @@ struct buddy *buddy_get_embed_at_alignment(unsigned char *main, size_t memory_si
     return (struct buddy *)(main + check_result.offset);
 }
 
+struct buddy *buddy_clone(unsigned char *at, struct buddy *buddy, unsigned char *new_main) {
+    struct buddy *clone;
+
+    if ((buddy == NULL) || (new_main == NULL)) {
+        return NULL;
+    }
+    if (buddy_embedded_mode(buddy)) {
+        /* Keep the same offset from the arena */
+        at = new_main + buddy->arena.main_offset;
+    } else if ((at == NULL) || (at == new_main)) {
+        return NULL;
+    }
+    if ((((uintptr_t) at) % BUDDY_ALIGNOF(struct buddy)) != 0) {
+        return NULL;
+    }
+    if ((((uintptr_t) new_main) % BUDDY_ALIGNOF(size_t)) != 0) {
+        return NULL;
+    }
+
+    memmove(at, buddy, buddy_sizeof_alignment(buddy->memory_size, buddy_alignment(buddy)));
+    clone = (struct buddy *) at;
+    if (buddy_relative_mode(clone)) {
+        clone->arena.main_offset = at - new_main;
+    } else {
+        clone->arena.main = new_main;
+    }
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+    /* A log describes a single allocator */
+    clone->log = NULL;
+#endif
+    return clone;
+}
+
 struct buddy *buddy_resize(struct buddy *buddy, size_t new_memory_size) {
-    if (new_memory_size == buddy->memory_size) {
+    struct buddy *resized;
+
+    /* An embedded allocator is resized with the size of the whole region */
+    if ((! buddy_embedded_mode(buddy)) && (new_memory_size == buddy->memory_size)) {
         return buddy;
     }
 
-    if (buddy_relative_mode(buddy)) {
-        return buddy_resize_embedded(buddy, new_memory_size);
+    buddy_deferred_free_flush(buddy);
+
+    if (buddy_embedded_mode(buddy)) {
+        resized = buddy_resize_embedded(buddy, new_memory_size);
     } else {
-        return buddy_resize_standard(buddy, new_memory_size);
+        resized = buddy_resize_standard(buddy, new_memory_size);
     }
+    if (resized) {
+        buddy_log_append(resized, BUDDY_LOG_RESIZE, new_memory_size, 0);
+    }
+    return resized;
 }
 
 static struct buddy *buddy_resize_standard(struct buddy *buddy, size_t new_memory_size) {
     size_t new_buddy_tree_order;
+#if defined(BUDDY_EXPERIMENTAL_ZERO_TRACKING) || defined(BUDDY_EXPERIMENTAL_DIRTY_PAGES)
+    size_t old_buddy_tree_order = buddy_tree_order(buddy_tree(buddy));
+#endif
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    size_t old_memory_size = buddy->memory_size;
+#endif
 
     /* Trim down memory to alignment */
-    if (new_memory_size % buddy->alignment) {
-        new_memory_size -= (new_memory_size % buddy->alignment);
+    if (new_memory_size % buddy_alignment(buddy)) {
+        new_memory_size -= (new_memory_size % buddy_alignment(buddy));
     }
 
+#ifdef BUDDY_STATIC_ORDER
+    /* The tree order is fixed */
+    if (buddy_sizeof_alignment(new_memory_size, buddy_alignment(buddy)) == 0) {
+        return NULL;
+    }
+#endif
+
     /* Account for tree use */
     if (!buddy_is_free(buddy, new_memory_size)) {
         return NULL;
@@ -653,13 +1162,53 @@ static struct buddy *buddy_resize_standard(struct buddy *buddy, size_t new_memor
     buddy_toggle_virtual_slots(buddy, 0);
 
     /* Calculate new tree order and resize it */
-    new_buddy_tree_order = buddy_tree_order_for_memory(new_memory_size, buddy->alignment);
+    new_buddy_tree_order = buddy_tree_order_for_memory(new_memory_size, buddy_alignment(buddy));
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+    /* The dirty page bits come last - move them out of the way first */
+    if (new_buddy_tree_order > old_buddy_tree_order) {
+        buddy_dirty_bits_move(buddy, old_buddy_tree_order, new_buddy_tree_order);
+    }
+#endif
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    /* The known-zero bits follow the tree - move them out of the way before it grows */
+    if (new_buddy_tree_order > old_buddy_tree_order) {
+        buddy_zero_bits_move(buddy, old_buddy_tree_order, new_buddy_tree_order);
+    }
+#endif
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+    /* The tentative blocks stay in place but their positions move to another depth */
+    for (size_t i = 0; i < BUDDY_TENTATIVE_SLOTS; i++) {
+        if (buddy->tentative[i]) {
+            buddy->tentative[i] = buddy_tree_index_for_order(buddy->tentative[i],
+                buddy_tree_order(buddy_tree(buddy)), new_buddy_tree_order);
+        }
+    }
+#endif
     buddy_tree_resize(buddy_tree(buddy), (uint8_t) new_buddy_tree_order);
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    /* .. or move them back after it has shrunk */
+    if (new_buddy_tree_order < old_buddy_tree_order) {
+        buddy_zero_bits_move(buddy, old_buddy_tree_order, new_buddy_tree_order);
+    }
+    /* Memory that was outside of the arena is of unknown content */
+    if (new_memory_size > old_memory_size) {
+        bitset_clear_range(buddy_zero_bits(buddy, new_buddy_tree_order),
+            bitset_range(old_memory_size / buddy_alignment(buddy), (new_memory_size / buddy_alignment(buddy)) - 1));
+    }
+#endif
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+    if (new_buddy_tree_order < old_buddy_tree_order) {
+        buddy_dirty_bits_move(buddy, old_buddy_tree_order, new_buddy_tree_order);
+    }
+#endif
 
     /* Store the new memory size and reconstruct any virtual slots */
     buddy->memory_size = new_memory_size;
     buddy_toggle_virtual_slots(buddy, 1);
 
+    /* Resizing is not tracked */
+    buddy_tree_discard_changes(buddy_tree(buddy));
+
     /* Resize successful */
     return buddy;
 }
@@ -670,7 +1219,7 @@ static struct buddy *buddy_resize_embedded(struct buddy *buddy, size_t new_memor
     struct buddy *resized, *relocated;
 
     /* Ensure that the embedded allocator can fit */
-    check_result = buddy_embed_offset(new_memory_size, buddy->alignment);
+    check_result = buddy_embed_offset(new_memory_size, buddy_alignment(buddy));
     if (! check_result.can_fit) {
         return NULL;
     }
@@ -699,6 +1248,7 @@ bool buddy_can_shrink(struct buddy *buddy) {
     if (buddy == NULL) {
         return false;
     }
+    buddy_deferred_free_flush(buddy);
     return buddy_is_free(buddy, buddy->memory_size / 2);
 }
 
@@ -706,6 +1256,7 @@ bool buddy_is_empty(struct buddy *buddy) {
     if (buddy == NULL) {
         return false;
     }
+    buddy_deferred_free_flush(buddy);
     return buddy_is_free(buddy, 0);
 }
 
@@ -716,6 +1267,7 @@ bool buddy_is_full(struct buddy *buddy) {
     if (buddy == NULL) {
         return false;
     }
+    buddy_deferred_free_flush(buddy);
     tree = buddy_tree(buddy);
     pos = buddy_tree_root();
     return buddy_tree_status(tree, pos) == buddy_tree_order(tree);
@@ -732,8 +1284,9 @@ size_t buddy_arena_free_size(struct buddy *buddy) {
     size_t result = 0;
     struct buddy_tree *tree = buddy_tree(buddy);
     size_t tree_order = buddy_tree_order(tree);
-
     struct buddy_tree_walk_state state = buddy_tree_walk_state_root();
+
+    buddy_deferred_free_flush(buddy);
     do {
         size_t pos_status = buddy_tree_status(tree, state.current_pos);
         if (pos_status == (tree_order - state.current_pos.depth + 1)) { /* Fully-allocated */
@@ -749,7 +1302,11 @@ size_t buddy_arena_free_size(struct buddy *buddy) {
 }
 
 static unsigned int is_valid_alignment(size_t alignment) {
+#ifdef BUDDY_STATIC_ALIGNMENT
+    return alignment == BUDDY_STATIC_ALIGNMENT;
+#else
     return ceiling_power_of_two(alignment) == alignment;
+#endif
 }
 
 static size_t buddy_tree_order_for_memory(size_t memory_size, size_t alignment) {
@@ -758,6 +1315,10 @@ static size_t buddy_tree_order_for_memory(size_t memory_size, size_t alignment)
 }
 
 void *buddy_malloc(struct buddy *buddy, size_t requested_size) {
+    return buddy_allocate(buddy, requested_size, 0);
+}
+
+static void *buddy_allocate(struct buddy *buddy, size_t requested_size, size_t zeroed_size) {
     size_t target_depth;
     struct buddy_tree *tree;
     struct buddy_tree_pos pos;
@@ -782,22 +1343,40 @@ void *buddy_malloc(struct buddy *buddy, size_t requested_size) {
 
     target_depth = depth_for_size(buddy, requested_size);
     tree = buddy_tree(buddy);
+
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+    /* Reuse a slot of the same size that is pending release */
+    pos = buddy_deferred_free_take(buddy, target_depth);
+    if (buddy_tree_valid(tree, pos)) {
+        return buddy_slot_address(buddy, pos, zeroed_size);
+    }
+#endif
+
     pos = buddy_tree_find_free(tree, (uint8_t) target_depth);
 
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+    if ((! buddy_tree_valid(tree, pos)) && buddy->deferred_count) {
+        /* Release the pending slots and retry before failing */
+        buddy_deferred_free_flush(buddy);
+        pos = buddy_tree_find_free(tree, (uint8_t) target_depth);
+    }
+#endif
+
     if (! buddy_tree_valid(tree, pos)) {
         return NULL; /* no slot found */
     }
 
     /* Allocate the slot */
     buddy_tree_mark(tree, pos);
+    buddy_tree_commit_changes(tree);
+    buddy_log_append(buddy, BUDDY_LOG_MARK, pos.index, 0);
 
     /* Find and return the actual memory address */
-    return address_for_position(buddy, pos);
+    return buddy_slot_address(buddy, pos, zeroed_size);
 }
 
 void *buddy_calloc(struct buddy *buddy, size_t members_count, size_t member_size) {
     size_t total_size;
-    void *result;
 
     if (members_count == 0 || member_size == 0) {
         /* See the gleeful remark in malloc */
@@ -809,11 +1388,7 @@ void *buddy_calloc(struct buddy *buddy, size_t members_count, size_t member_size
         return NULL;
     }
     total_size = members_count * member_size;
-    result = buddy_malloc(buddy, total_size);
-    if (result) {
-        memset(result, 0, total_size);
-    }
-    return result;
+    return buddy_allocate(buddy, total_size, total_size);
 }
 
 void *buddy_realloc(struct buddy *buddy, void *ptr, size_t requested_size, bool ignore_data) {
@@ -842,6 +1417,8 @@ void *buddy_realloc(struct buddy *buddy, void *ptr, size_t requested_size, bool
         return NULL;
     }
 
+    buddy_deferred_free_flush(buddy);
+
     /* Find the position tracking this address */
     tree = buddy_tree(buddy);
     origin = position_for_address(buddy, (unsigned char *) ptr);
@@ -858,16 +1435,28 @@ void *buddy_realloc(struct buddy *buddy, void *ptr, size_t requested_size, bool
     if (! buddy_tree_valid(tree, new_pos)) {
         /* allocation failure, restore mark and return null */
         buddy_tree_mark(tree, origin);
+        buddy_tree_commit_changes(tree);
         return NULL;
     }
 
     if (origin.index == new_pos.index) {
         /* Allocated to the same slot, restore mark and return null */
         buddy_tree_mark(tree, origin);
+        buddy_tree_commit_changes(tree);
         return ptr;
     }
 
-    destination = address_for_position(buddy, new_pos);
+    destination = buddy_slot_address(buddy, new_pos, 0);
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+    {
+        /* A moved tentative block remains tentative */
+        size_t *entry = buddy_tentative_entry(buddy, origin.index);
+        if (entry) {
+            *entry = new_pos.index;
+        }
+    }
+#endif
 
     if (! ignore_data) {
         /* Copy the content */
@@ -878,6 +1467,9 @@ void *buddy_realloc(struct buddy *buddy, void *ptr, size_t requested_size, bool
 
     /* Allocate and return */
     buddy_tree_mark(tree, new_pos);
+    buddy_tree_commit_changes(tree);
+    buddy_log_append(buddy, BUDDY_LOG_RELEASE, origin.index, 0);
+    buddy_log_append(buddy, BUDDY_LOG_MARK, new_pos.index, 0);
     return destination;
 }
 
@@ -893,6 +1485,82 @@ void *buddy_reallocarray(struct buddy *buddy, void *ptr,
     return buddy_realloc(buddy, ptr, members_count * member_size, ignore_data);
 }
 
+bool buddy_realloc_in_place(struct buddy *buddy, void *ptr, size_t requested_size) {
+    unsigned char *dst, *main;
+    struct buddy_tree *tree;
+    struct buddy_tree_pos origin, target;
+    size_t target_depth;
+
+    if (buddy == NULL) {
+        return false;
+    }
+    if (ptr == NULL) {
+        return false;
+    }
+    if ((requested_size == 0) || (requested_size > buddy->memory_size)) {
+        return false;
+    }
+    dst = (unsigned char *)ptr;
+    main = buddy_main(buddy);
+    if ((dst < main) || (dst >= (main + buddy->memory_size))) {
+        return false;
+    }
+
+    buddy_deferred_free_flush(buddy);
+
+    /* Find the allocated position tracking this address */
+    tree = buddy_tree(buddy);
+    origin = position_for_address(buddy, dst);
+    if (! buddy_tree_valid(tree, origin)) {
+        return false;
+    }
+    if (buddy_tree_status(tree, origin) != (buddy_tree_order(tree) - origin.depth + 1)) {
+        return false;
+    }
+
+    /* Find the position of the target size that starts at the same address */
+    target_depth = depth_for_size(buddy, requested_size);
+    target = origin;
+    while (target.depth > target_depth) {
+        if (target.index & 1u) {
+            return false; /* a right child, the larger slot starts elsewhere */
+        }
+        target = buddy_tree_parent(target);
+    }
+    while (target.depth < target_depth) {
+        target = buddy_tree_left_child(target);
+    }
+    if (target.index == origin.index) {
+        return true;
+    }
+
+    /* Release the position and check that the target is free */
+    buddy_tree_release(tree, origin);
+    if (buddy_tree_status(tree, target)) {
+        /* The adjacent space is in use, restore the mark */
+        buddy_tree_mark(tree, origin);
+        buddy_tree_commit_changes(tree);
+        return false;
+    }
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+    {
+        /* A resized tentative block remains tentative */
+        size_t *entry = buddy_tentative_entry(buddy, origin.index);
+        if (entry) {
+            *entry = target.index;
+        }
+    }
+#endif
+
+    buddy_slot_address(buddy, target, 0);
+    buddy_tree_mark(tree, target);
+    buddy_tree_commit_changes(tree);
+    buddy_log_append(buddy, BUDDY_LOG_RELEASE, origin.index, 0);
+    buddy_log_append(buddy, BUDDY_LOG_MARK, target.index, 0);
+    return true;
+}
+
 void buddy_free(struct buddy *buddy, void *ptr) {
     unsigned char *dst, *main;
     struct buddy_tree *tree;
@@ -918,8 +1586,22 @@ void buddy_free(struct buddy *buddy, void *ptr) {
         return;
     }
 
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+    buddy_tentative_forget(buddy, pos.index);
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+    if (buddy->buddy_flags & BUDDY_DEFERRED_FREE_MODE) {
+        /* Keep the position marked, it will be reused or released in a batch */
+        buddy_deferred_free_push(buddy, pos);
+        return;
+    }
+#endif
+
     /* Release the position */
     buddy_tree_release(tree, pos);
+    buddy_tree_commit_changes(tree);
+    buddy_log_append(buddy, BUDDY_LOG_RELEASE, pos.index, 0);
 }
 
 enum buddy_safe_free_status buddy_safe_free(struct buddy* buddy, void* ptr, size_t requested_size) {
@@ -941,6 +1623,8 @@ enum buddy_safe_free_status buddy_safe_free(struct buddy* buddy, void* ptr, size
         return BUDDY_SAFE_FREE_INVALID_ADDRESS;
     }
 
+    buddy_deferred_free_flush(buddy);
+
     /* Find an allocated position tracking this address */
     tree = buddy_tree(buddy);
     pos = position_for_address(buddy, dst);
@@ -950,8 +1634,8 @@ enum buddy_safe_free_status buddy_safe_free(struct buddy* buddy, void* ptr, size
     }
 
     allocated_size_for_depth = size_for_depth(buddy, pos.depth);
-    if (requested_size < buddy->alignment) {
-        requested_size = buddy->alignment;
+    if (requested_size < buddy_alignment(buddy)) {
+        requested_size = buddy_alignment(buddy);
     }
     if (requested_size > allocated_size_for_depth) {
         return BUDDY_SAFE_FREE_SIZE_MISMATCH;
@@ -962,6 +1646,7 @@ enum buddy_safe_free_status buddy_safe_free(struct buddy* buddy, void* ptr, size
 
     /* Release the position */
     status = buddy_tree_release(tree, pos);
+    buddy_tree_commit_changes(tree);
 
     switch (status) {
     case BUDDY_TREE_RELEASE_FAIL_PARTIALLY_USED:
@@ -969,10 +1654,94 @@ enum buddy_safe_free_status buddy_safe_free(struct buddy* buddy, void* ptr, size
     case BUDDY_TREE_RELEASE_SUCCESS:
         break;
     }
+    buddy_log_append(buddy, BUDDY_LOG_RELEASE, pos.index, 0);
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+    buddy_tentative_forget(buddy, pos.index);
+#endif
 
     return BUDDY_SAFE_FREE_SUCCESS;
 }
 
+size_t buddy_usable_size(struct buddy *buddy, void *ptr) {
+    unsigned char *dst, *main;
+    struct buddy_tree *tree;
+    struct buddy_tree_pos pos;
+
+    if (buddy == NULL) {
+        return 0;
+    }
+    if (ptr == NULL) {
+        return 0;
+    }
+    dst = (unsigned char *)ptr;
+    main = buddy_main(buddy);
+    if ((dst < main) || (dst >= (main + buddy->memory_size))) {
+        return 0;
+    }
+
+    tree = buddy_tree(buddy);
+    pos = position_for_address(buddy, dst);
+    if (! buddy_tree_valid(tree, pos)) {
+        return 0;
+    }
+    /* A slot that is only partially used is not an allocation */
+    if (buddy_tree_status(tree, pos) != (buddy_tree_order(tree) - pos.depth + 1)) {
+        return 0;
+    }
+    return size_for_depth(buddy, pos.depth);
+}
+
+size_t buddy_malloc_sg(struct buddy *buddy, size_t requested_size,
+        struct buddy_segment *segments, size_t max_segments) {
+    struct buddy_tree *tree;
+    size_t count, root_status, slot_size;
+    void *slot;
+
+    if ((buddy == NULL) || (segments == NULL) || (max_segments == 0)) {
+        return 0;
+    }
+    if ((requested_size == 0) || (requested_size > buddy->memory_size)) {
+        return 0;
+    }
+    tree = buddy_tree(buddy);
+    count = 0;
+    while (count < max_segments) {
+        /* The rest fits in a single slot */
+        slot = buddy_malloc(buddy, requested_size);
+        if (slot) {
+            segments[count].base = slot;
+            segments[count].length = requested_size;
+            return count + 1;
+        }
+        /* Otherwise take the largest free slot whole, the root status gives its depth */
+        buddy_deferred_free_flush(buddy);
+        root_status = buddy_tree_status(tree, buddy_tree_root());
+        if (root_status == buddy_tree_order(tree)) {
+            break; /* full */
+        }
+        slot_size = size_for_depth(buddy, root_status + 1);
+        slot = buddy_malloc(buddy, slot_size);
+        segments[count].base = slot;
+        segments[count].length = slot_size;
+        count++;
+        requested_size -= slot_size;
+    }
+    buddy_free_sg(buddy, segments, count);
+    return 0;
+}
+
+void buddy_free_sg(struct buddy *buddy, struct buddy_segment *segments, size_t count) {
+    size_t i;
+
+    if ((buddy == NULL) || (segments == NULL)) {
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        buddy_free(buddy, segments[i].base);
+    }
+}
+
 void buddy_reserve_range(struct buddy *buddy, void *ptr, size_t requested_size) {
     buddy_toggle_range_reservation(buddy, ptr, requested_size, 1);
 }
@@ -998,6 +1767,7 @@ void *buddy_walk(struct buddy *buddy,
     if (fp == NULL) {
         return NULL;
     }
+    buddy_deferred_free_flush(buddy);
     main = buddy_main(buddy);
     effective_memory_size = buddy_effective_memory_size(buddy);
     tree = buddy_tree(buddy);
@@ -1022,58 +1792,365 @@ void *buddy_walk(struct buddy *buddy,
             continue;
         }
 
-        /* Current node is free or allocated, process */
-        pos_size = effective_memory_size >> (state.current_pos.depth - 1u);
-        addr = address_for_position(buddy, state.current_pos);
-        if (((size_t)(addr - main) + pos_size) > buddy->memory_size) {
-            /*
-             * Do not process virtual slots
-             * As virtual slots are on the right side of the tree
-             *  if we see a one with the current iteration order this
-             *  means that all subsequent slots will be virtual,
-             *  hence we can return early.
-             */
-            return NULL;
+        /* Current node is free or allocated, process */
+        pos_size = effective_memory_size >> (state.current_pos.depth - 1u);
+        addr = address_for_position(buddy, state.current_pos);
+        if (((size_t)(addr - main) + pos_size) > buddy->memory_size) {
+            /*
+             * Do not process virtual slots
+             * As virtual slots are on the right side of the tree
+             *  if we see a one with the current iteration order this
+             *  means that all subsequent slots will be virtual,
+             *  hence we can return early.
+             */
+            return NULL;
+        }
+        callback_result = (fp)(ctx, addr, pos_size, pos_status > 0);
+        if (callback_result != NULL) {
+            return callback_result;
+        }
+        state.going_up = 1;
+
+    } while (buddy_tree_walk(tree, &state));
+    return NULL;
+}
+
+unsigned char buddy_fragmentation(struct buddy *buddy) {
+    if (buddy == NULL) {
+        return 0;
+    }
+    buddy_deferred_free_flush(buddy);
+    return buddy_tree_fragmentation(buddy_tree(buddy));
+}
+
+void buddy_recover(struct buddy *buddy) {
+    if (buddy == NULL) {
+        return;
+    }
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+    /* The pending slots stay allocated, the lists may have been torn */
+    buddy_deferred_free_reset(buddy);
+#endif
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    memset(buddy_zero_bits(buddy, buddy_tree_order(buddy_tree(buddy))), 0,
+        buddy_zero_bits_sizeof(buddy_tree_order(buddy_tree(buddy))));
+#endif
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+    /* The dirty pages may have been torn, the next checkpoint takes everything */
+    memset(buddy_dirty_bits(buddy, buddy_tree_order(buddy_tree(buddy))), 0xFF,
+        bitset_sizeof(buddy_dirty_pages(buddy_tree_order(buddy_tree(buddy)), buddy_alignment(buddy))));
+#endif
+    /* The pending changes may have been torn as well */
+    buddy_tree_discard_changes(buddy_tree(buddy));
+    buddy_tree_rebuild(buddy_tree(buddy));
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+    /* Reclaim the blocks that were never published */
+    for (size_t i = 0; i < BUDDY_TENTATIVE_SLOTS; i++) {
+        if (buddy->tentative[i]) {
+            struct buddy_tree_pos pos;
+            pos.index = buddy->tentative[i];
+            pos.depth = highest_bit_position(pos.index);
+            buddy_tree_release(buddy_tree(buddy), pos);
+            buddy->tentative[i] = 0;
+        }
+    }
+#endif
+}
+
+size_t buddy_serialize(struct buddy *buddy, unsigned char *out, size_t capacity) {
+    size_t tree_order, pos_status, offset, end, at;
+    struct buddy_tree *tree;
+    struct buddy_tree_walk_state state;
+    struct buddy_tree_pos test_pos;
+
+    if (buddy == NULL) {
+        return 0;
+    }
+    buddy_deferred_free_flush(buddy);
+    tree = buddy_tree(buddy);
+    tree_order = buddy_tree_order(tree);
+
+    at = buddy_varint_put(out, capacity, 0, buddy->memory_size);
+    at = buddy_varint_put(out, capacity, at, buddy_alignment(buddy));
+
+    /* Each slot is its depth and the gap from the end of the previous one */
+    end = 0;
+    state = buddy_tree_walk_state_root();
+    do {
+        pos_status = buddy_tree_status(tree, state.current_pos);
+        if (pos_status == 0) { /* Free */
+            state.going_up = 1;
+            continue;
+        }
+        if (pos_status != (tree_order - state.current_pos.depth + 1)) { /* Partially-allocated */
+            continue;
+        }
+        test_pos = buddy_tree_left_child(state.current_pos);
+        if (buddy_tree_valid(tree, test_pos) && buddy_tree_status(tree, test_pos)) {
+            continue; /* Allocated by its children */
+        }
+        state.going_up = 1;
+
+        offset = (size_t) (address_for_position(buddy, state.current_pos) - buddy_main(buddy));
+        if (offset >= buddy->memory_size) {
+            break; /* Virtual slots are restored by the allocator */
+        }
+        at = buddy_varint_put(out, capacity, at, state.current_pos.depth);
+        at = buddy_varint_put(out, capacity, at, (offset - end) / buddy_alignment(buddy));
+        end = offset + size_for_depth(buddy, state.current_pos.depth);
+    } while (buddy_tree_walk(tree, &state));
+
+    /* A zero depth terminates the list */
+    return buddy_varint_put(out, capacity, at, 0);
+}
+
+bool buddy_deserialize(struct buddy *buddy, const unsigned char *in, size_t length) {
+    size_t memory_size, alignment, at;
+    struct buddy_tree *tree;
+
+    if ((buddy == NULL) || (in == NULL)) {
+        return false;
+    }
+    at = 0;
+    if (! (buddy_varint_get(in, length, &at, &memory_size) && buddy_varint_get(in, length, &at, &alignment))) {
+        return false;
+    }
+    if ((memory_size != buddy->memory_size) || (alignment != buddy_alignment(buddy))) {
+        return false;
+    }
+    /* Validate everything before changing anything */
+    if (! buddy_deserialize_slots(buddy, in, length, at, false)) {
+        return false;
+    }
+
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+    buddy_deferred_free_reset(buddy);
+#endif
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    memset(buddy_zero_bits(buddy, buddy_tree_order(buddy_tree(buddy))), 0,
+        buddy_zero_bits_sizeof(buddy_tree_order(buddy_tree(buddy))));
+#endif
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+    memset(buddy->tentative, 0, sizeof(buddy->tentative));
+#endif
+    tree = buddy_tree(buddy);
+    buddy_tree_clear(tree);
+    buddy_toggle_virtual_slots(buddy, 1);
+    buddy_deserialize_slots(buddy, in, length, at, true);
+    buddy_tree_rebuild(tree);
+    buddy_tree_commit_changes(tree);
+    return true;
+}
+
+#ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
+void buddy_enable_change_tracking(struct buddy* buddy, void* context,
+        void (*tracker) (void*, struct buddy_change_range*, size_t)) {
+    struct buddy_tree *t = buddy_tree(buddy);
+    struct buddy_change_tracker *header = (struct buddy_change_tracker *) buddy_main(buddy);
+
+    /* Allocate memory for the change tracking header */
+    buddy_reserve_range(buddy, buddy_main(buddy), sizeof(struct buddy_change_tracker));
+
+    /* Fill in the change tracking header */
+    header->context = context;
+    header->tracker = tracker;
+    header->range_count = 0;
+
+    /* Indicate that the tree should perform change tracking */
+    buddy_tree_enable_change_tracking(t);
+}
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+void buddy_enable_deferred_free(struct buddy *buddy) {
+    buddy->buddy_flags |= BUDDY_DEFERRED_FREE_MODE;
+}
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+void *buddy_reserve(struct buddy *buddy, size_t requested_size) {
+    size_t *entry;
+    void *result;
+
+    if (buddy == NULL) {
+        return NULL;
+    }
+    entry = buddy_tentative_entry(buddy, 0);
+    if (entry == NULL) {
+        return NULL; /* table is full */
+    }
+    result = buddy_malloc(buddy, requested_size);
+    if (result) {
+        *entry = position_for_address(buddy, (unsigned char *) result).index;
+    }
+    return result;
+}
+
+void buddy_publish(struct buddy *buddy, void *ptr) {
+    struct buddy_tree_pos pos;
+
+    if (buddy == NULL) {
+        return;
+    }
+    if (ptr == NULL) {
+        return;
+    }
+    pos = position_for_address(buddy, (unsigned char *) ptr);
+    if (! buddy_tree_valid(buddy_tree(buddy), pos)) {
+        return;
+    }
+    buddy_tentative_forget(buddy, pos.index);
+}
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+void buddy_mark_zeroed(struct buddy *buddy, void *ptr, size_t requested_size) {
+    unsigned char *dst, *main;
+    size_t from, to;
+
+    if (buddy == NULL) {
+        return;
+    }
+    if (ptr == NULL) {
+        return;
+    }
+    dst = (unsigned char *)ptr;
+    main = buddy_main(buddy);
+    if ((dst < main) || (dst >= (main + buddy->memory_size))) {
+        return;
+    }
+    if (requested_size > (size_t)((main + buddy->memory_size) - dst)) {
+        requested_size = (size_t)((main + buddy->memory_size) - dst);
+    }
+
+    /* Only blocks that are entirely within the range are known to be zero */
+    from = ((size_t)(dst - main) + buddy_alignment(buddy) - 1) / buddy_alignment(buddy);
+    to = ((size_t)(dst - main) + requested_size) / buddy_alignment(buddy);
+    if (from < to) {
+        bitset_set_range(buddy_zero_bits(buddy, buddy_tree_order(buddy_tree(buddy))),
+            bitset_range(from, to - 1));
+    }
+}
+#endif
+
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+void buddy_mark_dirty(struct buddy *buddy, void *ptr, size_t requested_size) {
+    unsigned char *dst, *main;
+
+    if (buddy == NULL) {
+        return;
+    }
+    if ((ptr == NULL) || (requested_size == 0)) {
+        return;
+    }
+    dst = (unsigned char *)ptr;
+    main = buddy_main(buddy);
+    if ((dst < main) || (dst >= (main + buddy->memory_size))) {
+        return;
+    }
+    if (requested_size > (size_t)((main + buddy->memory_size) - dst)) {
+        requested_size = (size_t)((main + buddy->memory_size) - dst);
+    }
+    buddy_dirty_mark(buddy, (size_t)(dst - main), requested_size);
+}
+
+void buddy_checkpoint(struct buddy *buddy) {
+    size_t tree_order;
+
+    if (buddy == NULL) {
+        return;
+    }
+    tree_order = buddy_tree_order(buddy_tree(buddy));
+    memset(buddy_dirty_bits(buddy, tree_order), 0, bitset_sizeof(buddy_dirty_pages(tree_order, buddy_alignment(buddy))));
+}
+
+void *buddy_walk_dirty(struct buddy *buddy, void *(fp)(void *ctx, void *addr, size_t length), void *ctx) {
+    unsigned char *main, *bits;
+    struct buddy_tree *tree;
+    struct buddy_tree_pos pos;
+    size_t page_depth, page_size, page, run;
+    void *callback_result;
+
+    if (buddy == NULL) {
+        return NULL;
+    }
+    if (fp == NULL) {
+        return NULL;
+    }
+    buddy_deferred_free_flush(buddy);
+    main = buddy_main(buddy);
+    tree = buddy_tree(buddy);
+    bits = buddy_dirty_bits(buddy, buddy_tree_order(tree));
+
+    /* A page is live if the tree node covering it is not free */
+    page_depth = depth_for_size(buddy, BUDDY_DIRTY_PAGE_SIZE);
+    page_size = size_for_depth(buddy, page_depth);
+    pos.depth = page_depth;
+
+    run = 0;
+    for (page = 0; (page * BUDDY_DIRTY_PAGE_SIZE) < buddy->memory_size; page++) {
+        pos.index = two_to_the_power_of(page_depth - 1) + ((page * BUDDY_DIRTY_PAGE_SIZE) / page_size);
+        if (bitset_test(bits, page) && (! buddy_tree_is_free(tree, pos))) {
+            run++;
+            continue;
         }
-        callback_result = (fp)(ctx, addr, pos_size, pos_status > 0);
-        if (callback_result != NULL) {
-            return callback_result;
+        if (run) {
+            callback_result = (fp)(ctx, main + ((page - run) * BUDDY_DIRTY_PAGE_SIZE), run * BUDDY_DIRTY_PAGE_SIZE);
+            if (callback_result != NULL) {
+                return callback_result;
+            }
+            run = 0;
         }
-        state.going_up = 1;
-
-    } while (buddy_tree_walk(tree, &state));
+    }
+    if (run) {
+        /* The last run may end with a partial page */
+        return (fp)(ctx, main + ((page - run) * BUDDY_DIRTY_PAGE_SIZE),
+            buddy->memory_size - ((page - run) * BUDDY_DIRTY_PAGE_SIZE));
+    }
     return NULL;
 }
+#endif
 
-unsigned char buddy_fragmentation(struct buddy *buddy) {
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+void buddy_enable_log(struct buddy *buddy, struct buddy_log *log) {
     if (buddy == NULL) {
-        return 0;
+        return;
     }
-    return buddy_tree_fragmentation(buddy_tree(buddy));
+    buddy->log = log;
 }
 
-#ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
-void buddy_enable_change_tracking(struct buddy* buddy, void* context, void (*tracker) (void*, unsigned char*, size_t)) {
-    struct buddy_tree *t = buddy_tree(buddy);
-    struct buddy_change_tracker *header = (struct buddy_change_tracker *) buddy_main(buddy);
-
-    /* Allocate memory for the change tracking header */
-    buddy_reserve_range(buddy, buddy_main(buddy), sizeof(struct buddy_change_tracker));
-
-    /* Fill in the change tracking header */
-    header->context = context;
-    header->tracker = tracker;
+struct buddy *buddy_apply_log(struct buddy *buddy, const unsigned char *in, size_t length, size_t *applied) {
+    size_t at, op, first, second;
 
-    /* Indicate that the tree should perform change tracking */
-    buddy_tree_enable_change_tracking(t);
+    *applied = 0;
+    if ((buddy == NULL) || (in == NULL)) {
+        return buddy;
+    }
+    at = 0;
+    while (at < length) {
+        op = in[at++];
+        second = 0;
+        if (! buddy_varint_get(in, length, &at, &first)) {
+            break;
+        }
+        if (((op == BUDDY_LOG_RESERVE) || (op == BUDDY_LOG_UNRESERVE))
+                && (! buddy_varint_get(in, length, &at, &second))) {
+            break;
+        }
+        if (! buddy_log_replay(&buddy, (unsigned int) op, first, second)) {
+            break;
+        }
+        *applied = at;
+    }
+    return buddy;
 }
 #endif
 
 
 static size_t depth_for_size(struct buddy *buddy, size_t requested_size) {
     size_t depth, effective_memory_size;
-    if (requested_size < buddy->alignment) {
-        requested_size = buddy->alignment;
+    if (requested_size < buddy_alignment(buddy)) {
+        requested_size = buddy_alignment(buddy);
     }
     depth = 1;
     effective_memory_size = buddy_effective_memory_size(buddy);
@@ -1085,7 +2162,16 @@ static size_t depth_for_size(struct buddy *buddy, size_t requested_size) {
 }
 
 static inline size_t size_for_depth(struct buddy *buddy, size_t depth) {
-    return ceiling_power_of_two(buddy->memory_size) >> (depth-1);
+    return buddy_effective_memory_size(buddy) >> (depth-1);
+}
+
+static inline size_t buddy_alignment(struct buddy *buddy) {
+#ifdef BUDDY_STATIC_ALIGNMENT
+    (void) buddy;
+    return BUDDY_STATIC_ALIGNMENT;
+#else
+    return buddy->alignment;
+#endif
 }
 
 static struct buddy_tree *buddy_tree(struct buddy *buddy) {
@@ -1093,7 +2179,13 @@ static struct buddy_tree *buddy_tree(struct buddy *buddy) {
 }
 
 static size_t buddy_effective_memory_size(struct buddy *buddy) {
+#if defined(BUDDY_STATIC_ORDER) && defined(BUDDY_STATIC_ALIGNMENT)
+    /* An aligned arena of a fixed tree order always rounds up to the same size */
+    (void) buddy;
+    return (size_t) BUDDY_STATIC_ALIGNMENT << (BUDDY_STATIC_ORDER - 1);
+#else
     return ceiling_power_of_two(buddy->memory_size);
+#endif
 }
 
 static size_t buddy_virtual_slots(struct buddy *buddy) {
@@ -1102,7 +2194,7 @@ static size_t buddy_virtual_slots(struct buddy *buddy) {
     if (effective_memory_size == memory_size) {
         return 0;
     }
-    return (effective_memory_size - memory_size) / buddy->alignment;
+    return (effective_memory_size - memory_size) / buddy_alignment(buddy);
 }
 
 static unsigned char *address_for_position(struct buddy *buddy, struct buddy_tree_pos pos) {
@@ -1112,7 +2204,7 @@ static unsigned char *address_for_position(struct buddy *buddy, struct buddy_tre
 }
 
 static struct buddy_tree_pos deepest_position_for_offset(struct buddy *buddy, size_t offset) {
-    size_t index = offset / buddy->alignment;
+    size_t index = offset / buddy_alignment(buddy);
     struct buddy_tree_pos pos = buddy_tree_leftmost_child(buddy_tree(buddy));
     pos.index += index;
     return pos;
@@ -1127,7 +2219,7 @@ static struct buddy_tree_pos position_for_address(struct buddy *buddy, const uns
     main = buddy_main(buddy);
     offset = (size_t) (addr - main);
 
-    if (offset % buddy->alignment) {
+    if (offset % buddy_alignment(buddy)) {
         return INVALID_POS; /* invalid alignment */
     }
 
@@ -1161,6 +2253,10 @@ static unsigned int buddy_relative_mode(struct buddy *buddy) {
     return (unsigned int)buddy->buddy_flags & BUDDY_RELATIVE_MODE;
 }
 
+static unsigned int buddy_embedded_mode(struct buddy *buddy) {
+    return ((unsigned int)buddy->buddy_flags & (BUDDY_RELATIVE_MODE | BUDDY_EXTERNAL_MODE)) == BUDDY_RELATIVE_MODE;
+}
+
 static void buddy_toggle_virtual_slots(struct buddy *buddy, unsigned int state) {
     size_t delta, memory_size, effective_memory_size;
     struct buddy_tree *tree;
@@ -1233,11 +2329,15 @@ static void buddy_toggle_range_reservation(struct buddy *buddy, void *ptr, size_
         return;
     }
 
+    buddy_deferred_free_flush(buddy);
+
     /* Find the deepest position tracking this address */
     tree = buddy_tree(buddy);
     offset = (size_t) (dst - main);
     pos = deepest_position_for_offset(buddy, offset);
 
+    buddy_log_append(buddy, state ? BUDDY_LOG_RESERVE : BUDDY_LOG_UNRESERVE, offset, requested_size);
+
     /* Advance one position at a time and process */
     while (requested_size) {
         if (state) {
@@ -1246,9 +2346,18 @@ static void buddy_toggle_range_reservation(struct buddy *buddy, void *ptr, size_
         else {
             buddy_tree_release(tree, pos);
         }
-        requested_size = (requested_size < buddy->alignment) ? 0 : (requested_size - buddy->alignment);
+        requested_size = (requested_size < buddy_alignment(buddy)) ? 0 : (requested_size - buddy_alignment(buddy));
         pos.index++;
     }
+    buddy_tree_commit_changes(tree);
+
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    if (state) {
+        /* Reserved memory is handed out to the caller */
+        bitset_clear_range(buddy_zero_bits(buddy, buddy_tree_order(tree)),
+            bitset_range(offset / buddy_alignment(buddy), (pos.index - 1) - buddy_tree_leftmost_child(tree).index));
+    }
+#endif
 
     return;
 }
@@ -1266,7 +2375,7 @@ static bool buddy_is_free(struct buddy *buddy, size_t from) {
     effective_memory_size = buddy_effective_memory_size(buddy);
     virtual_slots = buddy_virtual_slots(buddy);
     to = effective_memory_size -
-        ((virtual_slots ? (virtual_slots + 1) : 1) * buddy->alignment);
+        ((virtual_slots ? (virtual_slots + 1) : 1) * buddy_alignment(buddy));
 
     tree = buddy_tree(buddy);
 
@@ -1320,12 +2429,345 @@ static struct buddy_embed_check buddy_embed_offset(size_t memory_size, size_t al
     return check_result;
 }
 
+static size_t buddy_varint_put(unsigned char *out, size_t capacity, size_t at, size_t value) {
+    /* Seven bits per byte, the high bit marks that more follow */
+    do {
+        if (at < capacity) {
+            out[at] = (unsigned char) ((value & 0x7Fu) | ((value > 0x7Fu) ? 0x80u : 0u));
+        }
+        at++;
+        value >>= 7;
+    } while (value);
+    return at;
+}
+
+static bool buddy_varint_get(const unsigned char *in, size_t length, size_t *at, size_t *value) {
+    size_t shift = 0;
+
+    *value = 0;
+    while (*at < length) {
+        unsigned char byte = in[(*at)++];
+        if ((shift >= (sizeof(size_t) * CHAR_BIT)) || (((size_t) (byte & 0x7Fu) << shift) >> shift) != (byte & 0x7Fu)) {
+            return false; /* overflow */
+        }
+        *value |= (size_t) (byte & 0x7Fu) << shift;
+        if (! (byte & 0x80u)) {
+            return true;
+        }
+        shift += 7;
+    }
+    return false; /* truncated */
+}
+
+static bool buddy_deserialize_slots(struct buddy *buddy, const unsigned char *in, size_t length,
+        size_t at, bool apply) {
+    size_t tree_order = buddy_tree_order(buddy_tree(buddy));
+    size_t end = 0;
+    size_t depth, gap, slot_size;
+    struct buddy_tree_pos pos;
+
+    for (;;) {
+        if (! buddy_varint_get(in, length, &at, &depth)) {
+            return false;
+        }
+        if (depth == 0) {
+            return true;
+        }
+        if ((depth > tree_order) || (! buddy_varint_get(in, length, &at, &gap))) {
+            return false;
+        }
+        slot_size = size_for_depth(buddy, depth);
+        if (gap > ((buddy->memory_size - end) / buddy_alignment(buddy))) {
+            return false; /* past the arena */
+        }
+        end += gap * buddy_alignment(buddy);
+        if ((end % slot_size) || (slot_size > (buddy->memory_size - end))) {
+            return false; /* misaligned or past the arena */
+        }
+        if (apply) {
+            pos.depth = depth;
+            pos.index = two_to_the_power_of(depth - 1u) + (end / slot_size);
+            buddy_tree_mark_unlinked(buddy_tree(buddy), pos);
+        }
+        end += slot_size;
+    }
+}
+
+static void buddy_deferred_free_flush(struct buddy *buddy) {
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+    size_t pending[BUDDY_DEFERRED_FREE_SLOTS];
+    size_t count = 0;
+    unsigned char slot;
+
+    if (! buddy->deferred_count) {
+        return;
+    }
+    for (size_t depth = 0; depth < sizeof(buddy->deferred_top); depth++) {
+        for (slot = buddy->deferred_top[depth]; slot; slot = buddy->deferred_next[slot - 1]) {
+            pending[count++] = buddy->deferred[slot - 1];
+        }
+    }
+    buddy_tree_release_batch(buddy_tree(buddy), pending, count);
+    buddy_tree_commit_changes(buddy_tree(buddy));
+    for (size_t i = 0; i < count; i++) {
+        buddy_log_append(buddy, BUDDY_LOG_RELEASE, pending[i], 0);
+    }
+    buddy_deferred_free_reset(buddy);
+#else
+    (void) buddy;
+#endif
+}
+
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+static void buddy_deferred_free_reset(struct buddy *buddy) {
+    buddy->deferred_count = 0;
+    memset(buddy->deferred_top, 0, sizeof(buddy->deferred_top));
+    for (size_t i = 0; i < BUDDY_DEFERRED_FREE_SLOTS; i++) {
+        buddy->deferred_next[i] = (unsigned char) ((i + 2) % (BUDDY_DEFERRED_FREE_SLOTS + 1));
+    }
+    buddy->deferred_unused = 1;
+}
+
+static void buddy_deferred_free_push(struct buddy *buddy, struct buddy_tree_pos pos) {
+    struct buddy_tree *tree = buddy_tree(buddy);
+    unsigned char *top = &buddy->deferred_top[pos.depth - 1];
+    unsigned char slot;
+
+    if (buddy_tree_status(tree, pos) != (buddy_tree_order(tree) - pos.depth + 1)) {
+        return; /* not an allocated slot */
+    }
+    for (slot = *top; slot; slot = buddy->deferred_next[slot - 1]) {
+        if (buddy->deferred[slot - 1] == pos.index) {
+            return; /* already pending */
+        }
+    }
+    if (! buddy->deferred_unused) {
+        buddy_deferred_free_flush(buddy);
+    }
+
+    /* Move a slot from the unused list to the top of this depth */
+    slot = buddy->deferred_unused;
+    buddy->deferred_unused = buddy->deferred_next[slot - 1];
+    buddy->deferred[slot - 1] = pos.index;
+    buddy->deferred_next[slot - 1] = *top;
+    *top = slot;
+    buddy->deferred_count++;
+}
+
+static struct buddy_tree_pos buddy_deferred_free_take(struct buddy *buddy, size_t depth) {
+    unsigned char *top = &buddy->deferred_top[depth - 1];
+    unsigned char slot = *top;
+    struct buddy_tree_pos pos = INVALID_POS;
+
+    if (slot) {
+        /* Move the most recently freed slot of this depth to the unused list */
+        *top = buddy->deferred_next[slot - 1];
+        buddy->deferred_next[slot - 1] = buddy->deferred_unused;
+        buddy->deferred_unused = slot;
+        buddy->deferred_count--;
+
+        pos.index = buddy->deferred[slot - 1];
+        pos.depth = depth;
+    }
+    return pos;
+}
+#endif /* BUDDY_EXPERIMENTAL_DEFERRED_FREE */
+
+static unsigned char *buddy_slot_address(struct buddy *buddy, struct buddy_tree_pos pos, size_t zeroed_size) {
+    unsigned char *addr = address_for_position(buddy, pos);
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    unsigned char *bits = buddy_zero_bits(buddy, buddy_tree_order(buddy_tree(buddy)));
+    size_t first = (size_t)(addr - buddy_main(buddy)) / buddy_alignment(buddy);
+    size_t blocks = size_for_depth(buddy, pos.depth) / buddy_alignment(buddy);
+    size_t dirty, block = 0;
+
+    /* Clear the runs of blocks that are not known to be zero */
+    while ((block * buddy_alignment(buddy)) < zeroed_size) {
+        if (bitset_test(bits, first + block)) {
+            block++;
+            continue;
+        }
+        dirty = block;
+        while (((block * buddy_alignment(buddy)) < zeroed_size) && (! bitset_test(bits, first + block))) {
+            block++;
+        }
+        memset(addr + (dirty * buddy_alignment(buddy)), 0,
+            ((block * buddy_alignment(buddy)) < zeroed_size ? (block * buddy_alignment(buddy)) : zeroed_size)
+                - (dirty * buddy_alignment(buddy)));
+    }
+
+    /* The slot is handed out and its content is no longer known */
+    bitset_clear_range(bits, bitset_range(first, first + blocks - 1));
+#else
+    if (zeroed_size) {
+        memset(addr, 0, zeroed_size);
+    }
+#endif
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+    buddy_dirty_mark(buddy, (size_t)(addr - buddy_main(buddy)), size_for_depth(buddy, pos.depth));
+#endif
+    return addr;
+}
+
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+static size_t buddy_zero_bits_sizeof(size_t tree_order) {
+    /* A bit per leaf, the tree has 2^(order-1) of them */
+    return bitset_sizeof(two_to_the_power_of(tree_order - 1));
+}
+
+static unsigned char *buddy_zero_bits(struct buddy *buddy, size_t tree_order) {
+    return (unsigned char *)buddy_tree(buddy) + buddy_tree_sizeof((uint8_t) tree_order);
+}
+
+static void buddy_zero_bits_move(struct buddy *buddy, size_t from_order, size_t to_order) {
+    size_t from_size = buddy_zero_bits_sizeof(from_order);
+    size_t to_size = buddy_zero_bits_sizeof(to_order);
+    /* Leaves keep their index across a resize, the trailing ones are cleared by the caller */
+    memmove(buddy_zero_bits(buddy, to_order), buddy_zero_bits(buddy, from_order),
+        from_size < to_size ? from_size : to_size);
+}
+#endif /* BUDDY_EXPERIMENTAL_ZERO_TRACKING */
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+static size_t *buddy_tentative_entry(struct buddy *buddy, size_t index) {
+    for (size_t i = 0; i < BUDDY_TENTATIVE_SLOTS; i++) {
+        if (buddy->tentative[i] == index) {
+            return &buddy->tentative[i];
+        }
+    }
+    return NULL;
+}
+
+static void buddy_tentative_forget(struct buddy *buddy, size_t index) {
+    size_t *entry = buddy_tentative_entry(buddy, index);
+    if (entry) {
+        *entry = 0;
+    }
+}
+#endif /* BUDDY_EXPERIMENTAL_TWO_PHASE */
+
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+static size_t buddy_dirty_pages(size_t tree_order, size_t alignment) {
+    /* A bit per page of the memory covered by the tree */
+    size_t covered = two_to_the_power_of(tree_order - 1) * alignment;
+    return (covered + BUDDY_DIRTY_PAGE_SIZE - 1) / BUDDY_DIRTY_PAGE_SIZE;
+}
+
+static unsigned char *buddy_dirty_bits(struct buddy *buddy, size_t tree_order) {
+    unsigned char *bits = (unsigned char *)buddy_tree(buddy) + buddy_tree_sizeof((uint8_t) tree_order);
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+    bits += buddy_zero_bits_sizeof(tree_order);
+#endif
+    return bits;
+}
+
+static void buddy_dirty_bits_move(struct buddy *buddy, size_t from_order, size_t to_order) {
+    size_t from_size = bitset_sizeof(buddy_dirty_pages(from_order, buddy_alignment(buddy)));
+    size_t to_size = bitset_sizeof(buddy_dirty_pages(to_order, buddy_alignment(buddy)));
+    unsigned char *to = buddy_dirty_bits(buddy, to_order);
+
+    /* Pages keep their index across a resize, the trailing ones were never handed out */
+    memmove(to, buddy_dirty_bits(buddy, from_order), from_size < to_size ? from_size : to_size);
+    if (to_size > from_size) {
+        memset(to + from_size, 0, to_size - from_size);
+    }
+}
+
+static void buddy_dirty_mark(struct buddy *buddy, size_t offset, size_t length) {
+    bitset_set_range(buddy_dirty_bits(buddy, buddy_tree_order(buddy_tree(buddy))),
+        bitset_range(offset / BUDDY_DIRTY_PAGE_SIZE, (offset + length - 1) / BUDDY_DIRTY_PAGE_SIZE));
+}
+#endif /* BUDDY_EXPERIMENTAL_DIRTY_PAGES */
+
+static void buddy_log_append(struct buddy *buddy, unsigned int op, size_t first, size_t second) {
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+    struct buddy_log *log = buddy->log;
+    /* An op byte and up to two varints */
+    unsigned char record[1 + 2 * ((sizeof(size_t) * CHAR_BIT + 6) / 7)];
+    size_t length;
+
+    if (log == NULL) {
+        return;
+    }
+    record[0] = (unsigned char) op;
+    length = buddy_varint_put(record, sizeof(record), 1, first);
+    if ((op == BUDDY_LOG_RESERVE) || (op == BUDDY_LOG_UNRESERVE)) {
+        length = buddy_varint_put(record, sizeof(record), length, second);
+    }
+    if (length > (log->capacity - (log->head - log->tail))) {
+        log->dropped++;
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        log->buffer[(log->head + i) % log->capacity] = record[i];
+    }
+    log->head += length;
+#else
+    (void) buddy;
+    (void) op;
+    (void) first;
+    (void) second;
+#endif
+}
+
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+static bool buddy_log_replay(struct buddy **buddy, unsigned int op, size_t first, size_t second) {
+    struct buddy_tree *tree = buddy_tree(*buddy);
+    struct buddy_tree_pos pos;
+    struct buddy *resized;
+
+    pos.index = first;
+    pos.depth = highest_bit_position(first);
+    switch (op) {
+    case BUDDY_LOG_MARK:
+        if ((! buddy_tree_valid(tree, pos)) || (! buddy_tree_is_free(tree, pos))) {
+            return false;
+        }
+        buddy_tree_mark(tree, pos);
+        buddy_tree_commit_changes(tree);
+        break;
+    case BUDDY_LOG_RELEASE:
+        /* Only a slot that was handed out as a whole, not one that is full through its children */
+        if ((! buddy_tree_valid(tree, pos))
+                || (buddy_tree_status(tree, pos) != (buddy_tree_order(tree) - pos.depth + 1))
+                || (buddy_tree_valid(tree, buddy_tree_left_child(pos))
+                    && buddy_tree_status(tree, buddy_tree_left_child(pos)))) {
+            return false;
+        }
+        buddy_tree_release(tree, pos);
+        buddy_tree_commit_changes(tree);
+        break;
+    case BUDDY_LOG_RESERVE:
+    case BUDDY_LOG_UNRESERVE:
+        if ((first > (*buddy)->memory_size) || (second > ((*buddy)->memory_size - first))) {
+            return false;
+        }
+        buddy_toggle_range_reservation(*buddy, buddy_main(*buddy) + first, second, op == BUDDY_LOG_RESERVE);
+        return true;
+    case BUDDY_LOG_RESIZE:
+        resized = buddy_resize(*buddy, first);
+        if (resized == NULL) {
+            return false;
+        }
+        *buddy = resized;
+        return true;
+    default:
+        return false;
+    }
+    /* Pass the change on to the replica's own log */
+    buddy_log_append(*buddy, op, first, 0);
+    return true;
+}
+#endif /* BUDDY_EXPERIMENTAL_OP_LOG */
+
 void buddy_debug(struct buddy *buddy) {
     BUDDY_PRINTF("buddy allocator at: %p arena at: %p\n", (void *)buddy, (void *)buddy_main(buddy));
     BUDDY_PRINTF("memory size: %zu\n", buddy->memory_size);
     BUDDY_PRINTF("mode: ");
-    if (buddy_relative_mode(buddy)) {
+    if (buddy_embedded_mode(buddy)) {
         BUDDY_PRINTF("embedded");
+    } else if (buddy_relative_mode(buddy)) {
+        BUDDY_PRINTF("standard, relative");
     } else {
         BUDDY_PRINTF("standard");
     }
@@ -1378,6 +2820,7 @@ static size_t read_from_internal_position(unsigned char *bitset, struct internal
 static inline unsigned char compare_with_internal_position(unsigned char *bitset, struct internal_position pos, size_t value);
 
 #ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
+static struct buddy_change_tracker *buddy_tree_change_tracker(struct buddy_tree *t);
 static inline void buddy_tree_track_change(struct buddy_tree* t, unsigned char* addr, size_t length);
 #endif /* BUDDY_EXPERIMENTAL_CHANGE_TRACKING */
 
@@ -1409,7 +2852,7 @@ static inline struct internal_position buddy_tree_internal_position_tree(
     struct internal_position p;
     size_t total_offset, local_index;
 
-    p.local_offset = t->order - buddy_tree_depth(pos) + 1;
+    p.local_offset = buddy_tree_order(t) - buddy_tree_depth(pos) + 1;
     total_offset = buddy_tree_size_for_order(t, (uint8_t) p.local_offset);
     local_index = buddy_tree_index_internal(pos);
     p.bitset_location = total_offset + (p.local_offset * local_index);
@@ -1543,11 +2986,21 @@ static void buddy_tree_shrink(struct buddy_tree *t, uint8_t desired_order) {
 }
 
 static bool buddy_tree_valid(struct buddy_tree *t, struct buddy_tree_pos pos) {
+#ifdef BUDDY_STATIC_ORDER
+    (void) t;
+    return pos.index && (pos.index < two_to_the_power_of(BUDDY_STATIC_ORDER));
+#else
     return pos.index && (pos.index < t->upper_pos_bound);
+#endif
 }
 
 static uint8_t buddy_tree_order(struct buddy_tree *t) {
+#ifdef BUDDY_STATIC_ORDER
+    (void) t;
+    return BUDDY_STATIC_ORDER;
+#else
     return t->order;
+#endif
 }
 
 static struct buddy_tree_pos buddy_tree_root(void) {
@@ -1556,7 +3009,7 @@ static struct buddy_tree_pos buddy_tree_root(void) {
 }
 
 static struct buddy_tree_pos buddy_tree_leftmost_child(struct buddy_tree *t) {
-    return buddy_tree_leftmost_child_internal(t->order);
+    return buddy_tree_leftmost_child_internal(buddy_tree_order(t));
 }
 
 static struct buddy_tree_pos buddy_tree_leftmost_child_internal(size_t tree_order) {
@@ -1632,7 +3085,13 @@ static void buddy_tree_populate_size_for_order(struct buddy_tree *t) {
 
 static inline size_t buddy_tree_size_for_order(struct buddy_tree *t,
          uint8_t to) {
+#ifdef BUDDY_STATIC_ORDER
+    /* The closed form of size_for_order, a shift and a subtraction for a constant order */
+    (void) t;
+    return ((size_t)(to + 2u) << (BUDDY_STATIC_ORDER - to)) - BUDDY_STATIC_ORDER - 2u;
+#else
     return *((size_t *)(((unsigned char *) t) + sizeof(*t)) + t->size_for_order_offset + to);
+#endif
 }
 
 static void write_to_internal_position(struct buddy_tree* t, struct internal_position pos, size_t value) {
@@ -1645,8 +3104,7 @@ static void write_to_internal_position(struct buddy_tree* t, struct internal_pos
     }
 
 #ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
-    /* Ignore the same bucket condition - we don't care if we track one more byte here */
-    buddy_tree_track_change(t, bitset, clear_range.to_bucket - clear_range.from_bucket + 1);
+    buddy_tree_track_change(t, bitset + clear_range.from_bucket, clear_range.to_bucket - clear_range.from_bucket + 1);
 #endif
 }
 
@@ -1668,7 +3126,7 @@ static struct buddy_tree_interval buddy_tree_interval(struct buddy_tree *t, stru
     result.from = pos;
     result.to = pos;
     depth = pos.depth;
-    while (depth != t->order) {
+    while (depth != buddy_tree_order(t)) {
         result.from = buddy_tree_left_child(result.from);
         result.to = buddy_tree_right_child(result.to);
         depth += 1;
@@ -1747,6 +3205,79 @@ static enum buddy_tree_release_status buddy_tree_release(struct buddy_tree *t, s
     return BUDDY_TREE_RELEASE_SUCCESS;
 }
 
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+static void buddy_tree_release_batch(struct buddy_tree *t, const size_t *indices, size_t count) {
+    struct buddy_tree_pos pos;
+    size_t i;
+
+    /*
+     * Clear all positions first and only then propagate upwards.
+     * A chain stops at the first ancestor that already holds the right value,
+     * so ancestors shared with an earlier chain are not written again.
+     */
+    for (i = 0; i < count; i++) {
+        pos.index = indices[i];
+        pos.depth = highest_bit_position(pos.index);
+        write_to_internal_position(t, buddy_tree_internal_position_tree(t, pos), 0);
+    }
+    for (i = 0; i < count; i++) {
+        pos.index = indices[i];
+        pos.depth = highest_bit_position(pos.index);
+        update_parent_chain(t, pos, buddy_tree_internal_position_tree(t, pos), 0);
+    }
+}
+#endif /* BUDDY_EXPERIMENTAL_DEFERRED_FREE */
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+static size_t buddy_tree_index_for_order(size_t index, size_t from_order, size_t to_order) {
+    size_t depth = highest_bit_position(index);
+    size_t local_index = index - two_to_the_power_of(depth - 1u);
+    return two_to_the_power_of(depth + to_order - from_order - 1u) + local_index;
+}
+#endif /* BUDDY_EXPERIMENTAL_TWO_PHASE */
+
+static void buddy_tree_clear(struct buddy_tree *t) {
+    memset(buddy_tree_bits(t), 0, bitset_sizeof(size_for_order(buddy_tree_order(t), 0)));
+}
+
+static void buddy_tree_mark_unlinked(struct buddy_tree *t, struct buddy_tree_pos pos) {
+    struct internal_position internal = buddy_tree_internal_position_tree(t, pos);
+    write_to_internal_position(t, internal, internal.local_offset);
+}
+
+static void buddy_tree_rebuild(struct buddy_tree *t) {
+    struct internal_position pos_internal, child_internal;
+    struct buddy_tree_pos pos;
+    size_t depth, count, status, left, right, target;
+    unsigned char *bits = buddy_tree_bits(t);
+
+    /* Go a row at a time from the bottom up, the rows are laid out contiguously */
+    for (depth = buddy_tree_order(t) - 1u; depth; depth--) {
+        pos.depth = depth;
+        pos.index = two_to_the_power_of(depth - 1u);
+        pos_internal = buddy_tree_internal_position_tree(t, pos);
+        child_internal = buddy_tree_internal_position_tree(t, buddy_tree_left_child(pos));
+        for (count = pos.index; count; count--) {
+            status = read_from_internal_position(bits, pos_internal);
+            left = read_from_internal_position(bits, child_internal);
+            child_internal.bitset_location += child_internal.local_offset;
+            right = read_from_internal_position(bits, child_internal);
+            child_internal.bitset_location += child_internal.local_offset;
+
+            if (left || right) {
+                target = (left <= right ? left : right) + 1;
+            } else {
+                /* Without used children the node is either free or allocated in full */
+                target = (status == pos_internal.local_offset) ? status : 0;
+            }
+            if (target != status) {
+                write_to_internal_position(t, pos_internal, target);
+            }
+            pos_internal.bitset_location += pos_internal.local_offset;
+        }
+    }
+}
+
 static void update_parent_chain(struct buddy_tree *t, struct buddy_tree_pos pos,
         struct internal_position pos_internal, size_t size_current) {
     size_t size_sibling, size_parent, target_parent;
@@ -1958,18 +3489,104 @@ static unsigned char buddy_tree_fragmentation(struct buddy_tree *t) {
 }
 
 #ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
+static struct buddy_change_tracker *buddy_tree_change_tracker(struct buddy_tree *t) {
+    if (!(t->flags & BUDDY_TREE_CHANGE_TRACKING)) {
+        return NULL;
+    }
+    return (struct buddy_change_tracker *) buddy_main(buddy_tree_buddy(t));
+}
+
 static inline void buddy_tree_track_change(struct buddy_tree* t, unsigned char* addr, size_t length) {
-    struct buddy_change_tracker *header;
+    struct buddy_change_tracker *header = buddy_tree_change_tracker(t);
+    struct buddy_change_range *ranges;
+    unsigned char *end = addr + length;
+    size_t i, gap, nearest, nearest_gap;
 
-    if (!(t->flags && BUDDY_TREE_CHANGE_TRACKING)) {
+    if (header == NULL) {
         return;
     }
+    ranges = header->ranges;
+
+    for (;;) {
+        /* Absorb the pending ranges that overlap or touch the new one */
+        i = 0;
+        while (i < header->range_count) {
+            if ((ranges[i].addr > end) || ((ranges[i].addr + ranges[i].length) < addr)) {
+                i++;
+                continue;
+            }
+            if (ranges[i].addr < addr) {
+                addr = ranges[i].addr;
+            }
+            if ((ranges[i].addr + ranges[i].length) > end) {
+                end = ranges[i].addr + ranges[i].length;
+            }
+            ranges[i] = ranges[--header->range_count];
+        }
+
+        if (header->range_count < BUDDY_CHANGE_TRACKING_RANGES) {
+            ranges[header->range_count].addr = addr;
+            ranges[header->range_count].length = (size_t) (end - addr);
+            header->range_count++;
+            return;
+        }
 
-    header = (struct buddy_change_tracker *) buddy_main(buddy_tree_buddy(t));
-    header->tracker(header->context, addr, length);
+        /* Out of ranges - stretch up to the nearest one so that it is absorbed along with the gap */
+        nearest = 0;
+        nearest_gap = SIZE_MAX;
+        for (i = 0; i < header->range_count; i++) {
+            gap = (ranges[i].addr > end) ? (size_t) (ranges[i].addr - end)
+                : (size_t) (addr - (ranges[i].addr + ranges[i].length));
+            if (gap < nearest_gap) {
+                nearest = i;
+                nearest_gap = gap;
+            }
+        }
+        if (ranges[nearest].addr > end) {
+            end = ranges[nearest].addr;
+        } else {
+            addr = ranges[nearest].addr + ranges[nearest].length;
+        }
+    }
 }
 #endif /* BUDDY_EXPERIMENTAL_CHANGE_TRACKING */
 
+static void buddy_tree_commit_changes(struct buddy_tree *t) {
+#ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
+    struct buddy_change_tracker *header = buddy_tree_change_tracker(t);
+    struct buddy_change_range range;
+    size_t i, j;
+
+    if ((header == NULL) || (header->range_count == 0)) {
+        return;
+    }
+    /* Report the ranges in address order */
+    for (i = 1; i < header->range_count; i++) {
+        range = header->ranges[i];
+        for (j = i; (j > 0) && (header->ranges[j - 1].addr > range.addr); j--) {
+            header->ranges[j] = header->ranges[j - 1];
+        }
+        header->ranges[j] = range;
+    }
+    header->tracker(header->context, header->ranges, header->range_count);
+    header->range_count = 0;
+#else
+    (void) t;
+#endif
+}
+
+static void buddy_tree_discard_changes(struct buddy_tree *t) {
+#ifdef BUDDY_EXPERIMENTAL_CHANGE_TRACKING
+    struct buddy_change_tracker *header = buddy_tree_change_tracker(t);
+
+    if (header != NULL) {
+        header->range_count = 0;
+    }
+#else
+    (void) t;
+#endif
+}
+
 /*
  * A char-backed bitset implementation
  */
@@ -2069,8 +3686,8 @@ static void bitset_shift_left(unsigned char *bitset, size_t from_pos, size_t to_
             bitset_clear(bitset, at-by);
         }
     }
-    bitset_clear_range(bitset, bitset_range(length, length+by-1));
-
+    /* Clear the vacated tail of the range */
+    bitset_clear_range(bitset, bitset_range(by < length ? to_pos - by : from_pos, to_pos - 1));
 }
 
 static void bitset_shift_right(unsigned char *bitset, size_t from_pos, size_t to_pos, size_t by) {
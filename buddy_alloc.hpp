@@ -0,0 +1,616 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ *
+ * C++ adapters for the binary buddy memory allocator
+ *
+ * Lets standard library containers and C++ code allocate from buddy_alloc arenas.
+ * The adapters do not own the allocator unless stated otherwise.
+ *
+ * To include and use it in your project do the following
+ * 1. Add buddy_alloc.h and buddy_alloc.hpp (this file) to your include directory
+ * 2. Include the header in places where you need to use the allocator
+ * 3. In one of your source files #define BUDDY_ALLOC_IMPLEMENTATION
+ *    and then import buddy_alloc.h. This will insert the implementation.
+ *
+ * The allocator and arena templates require C++11, the polymorphic memory resource requires C++17
+ * and the coroutine frame allocator requires C++20.
+ *
+ * Memory is returned with buddy_free, as the sizes that the adapters receive match their
+ * allocations by contract. With BUDDY_EXPERIMENTAL_DEFERRED_FREE this keeps frees deferred,
+ * while buddy_safe_free would flush the deferred lists on every call.
+ *
+ * Latest version is available at https://github.com/spaskalev/buddy_alloc
+ */
+
+#ifndef BUDDY_ALLOC_HPP
+#define BUDDY_ALLOC_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+/* MSVC reports the language version in _MSVC_LANG unless /Zc:__cplusplus is set */
+#if (__cplusplus >= 201703L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201703L))
+#include <memory_resource>
+#endif
+
+#include "buddy_alloc.h"
+
+namespace buddy_alloc {
+
+namespace detail {
+
+/*
+ * Allocates memory with the given alignment and throws std::bad_alloc on failure. Slots are
+ * aligned to their size within the arena, but the arena start may be less aligned.
+ */
+inline void *allocate(struct buddy *instance, std::size_t size, std::size_t alignment) {
+    void *result = buddy_malloc(instance, size);
+    if (result == nullptr) {
+        throw std::bad_alloc();
+    }
+    if ((reinterpret_cast<std::uintptr_t>(result) % alignment) != 0) {
+        buddy_free(instance, result);
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+} /* namespace detail */
+
+/*
+ * An allocator for standard library containers that allocates from a buddy allocator.
+ *
+ * Copies, rebinds and containers that use them share the allocator. It is propagated
+ * on container copy assignment, move assignment and swap, so memory is always returned
+ * to the arena that it came from. Allocators compare equal if they share an allocator.
+ */
+template <typename T>
+class allocator {
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+    typedef std::false_type is_always_equal;
+
+    template <typename U>
+    struct rebind {
+        typedef allocator<U> other;
+    };
+
+    explicit allocator(struct buddy *instance) noexcept : allocator_(instance) {}
+
+    template <typename U>
+    allocator(const allocator<U> &other) noexcept : allocator_(other.get()) {}
+
+    struct buddy *get() const noexcept {
+        return allocator_;
+    }
+
+    T *allocate(std::size_t n) {
+        if (n > max_size()) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(detail::allocate(allocator_, n * sizeof(T), alignof(T)));
+    }
+
+#if defined(__cpp_lib_allocate_at_least)
+    /* Returns the whole slot, which can hold more elements than requested */
+    std::allocation_result<T *, std::size_t> allocate_at_least(std::size_t n) {
+        T *result = allocate(n);
+        return {result, buddy_usable_size(allocator_, result) / sizeof(T)};
+    }
+#endif
+
+    void deallocate(T *ptr, std::size_t) noexcept {
+        buddy_free(allocator_, ptr);
+    }
+
+    std::size_t max_size() const noexcept {
+        return std::numeric_limits<std::size_t>::max() / sizeof(T);
+    }
+
+private:
+    struct buddy *allocator_;
+};
+
+template <typename T, typename U>
+bool operator==(const allocator<T> &a, const allocator<U> &b) noexcept {
+    return a.get() == b.get();
+}
+
+template <typename T, typename U>
+bool operator!=(const allocator<T> &a, const allocator<U> &b) noexcept {
+    return a.get() != b.get();
+}
+
+/*
+ * Whether objects of the type can be moved to another address by copying their bytes,
+ * without calling constructors or destructors. Specialize it for such types that are not
+ * trivially copyable.
+ */
+#if defined(__cpp_lib_trivially_relocatable)
+template <typename T>
+struct is_trivially_relocatable : std::is_trivially_relocatable<T> {};
+#else
+template <typename T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+#endif
+
+/*
+ * Resizes an allocation of old_n objects from a buddy allocator to hold new_n objects.
+ *
+ * All old_n objects must be alive. Objects past new_n are destroyed first. The allocation is then resized in place if
+ * possible, or the remaining objects are relocated to a new allocation - by copying their
+ * bytes for trivially relocatable types and with their move (or copy) constructors otherwise.
+ * Objects past old_n are not constructed. A null ptr allocates and a zero new_n frees.
+ * Returns nullptr if the memory cannot be allocated, in which case the remaining objects stay
+ * at ptr. If a constructor throws the exception is propagated and ptr is not changed further.
+ */
+template <typename T>
+T *realloc_typed(struct buddy *instance, T *ptr, std::size_t old_n, std::size_t new_n) {
+    std::size_t kept;
+    T *result;
+
+    if (new_n > (std::numeric_limits<std::size_t>::max() / sizeof(T))) {
+        return nullptr;
+    }
+    if (ptr == nullptr) {
+        old_n = 0;
+    }
+    kept = (old_n < new_n) ? old_n : new_n;
+    for (std::size_t i = kept; i < old_n; i++) {
+        ptr[i].~T();
+    }
+    if (new_n == 0) {
+        if (ptr != nullptr) {
+            buddy_free(instance, ptr);
+        }
+        return nullptr;
+    }
+    if ((ptr != nullptr) && buddy_realloc_in_place(instance, ptr, new_n * sizeof(T))) {
+        return ptr;
+    }
+
+    try {
+        result = static_cast<T *>(detail::allocate(instance, new_n * sizeof(T), alignof(T)));
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+    if (is_trivially_relocatable<T>::value) {
+        if (kept) {
+            std::memcpy(static_cast<void *>(result), static_cast<const void *>(ptr), kept * sizeof(T));
+        }
+    } else {
+        std::size_t moved = 0;
+        try {
+            for (; moved < kept; moved++) {
+                ::new (static_cast<void *>(result + moved)) T(std::move_if_noexcept(ptr[moved]));
+            }
+        } catch (...) {
+            while (moved) {
+                result[--moved].~T();
+            }
+            buddy_free(instance, result);
+            throw;
+        }
+        for (std::size_t i = 0; i < kept; i++) {
+            ptr[i].~T();
+        }
+    }
+    if (ptr != nullptr) {
+        buddy_free(instance, ptr);
+    }
+    return result;
+}
+
+/*
+ * An arena with its allocator, both sized at compile time and stored in the object.
+ *
+ * The tree order and the alignment are template parameters. A tree of order N manages
+ * Align * 2^(N-1) bytes, the metadata size is computed with BUDDY_METADATA_SIZE.
+ * Place large arenas in static storage. The arena cannot be copied or moved as the
+ * allocator refers to the memory in the object.
+ *
+ * The template parameters size the storage, the allocator itself runs the shared tree code.
+ * Define BUDDY_STATIC_ORDER and BUDDY_STATIC_ALIGNMENT to the same values to turn them into
+ * constants on the allocation paths, the template parameters must then match them.
+ */
+template <std::size_t Order, std::size_t Align>
+class arena {
+public:
+    static_assert(Order > 0, "the tree order must be positive");
+    static_assert((Align > 0) && ((Align & (Align - 1)) == 0), "the alignment must be a power of two");
+#ifdef BUDDY_STATIC_ORDER
+    static_assert(Order == BUDDY_STATIC_ORDER, "the tree order must match BUDDY_STATIC_ORDER");
+#endif
+#ifdef BUDDY_STATIC_ALIGNMENT
+    static_assert(Align == BUDDY_STATIC_ALIGNMENT, "the alignment must match BUDDY_STATIC_ALIGNMENT");
+#endif
+
+    static constexpr std::size_t order = Order;
+    static constexpr std::size_t alignment = Align;
+    static constexpr std::size_t size = Align << (Order - 1);
+    static constexpr std::size_t metadata_size = BUDDY_METADATA_SIZE(Order, Align);
+
+    arena() noexcept : allocator_(buddy_init_alignment(metadata_.data(), memory_.data(), size, Align)) {}
+
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+
+    struct buddy *get() const noexcept {
+        return allocator_;
+    }
+
+    unsigned char *data() noexcept {
+        return memory_.data();
+    }
+
+    void *allocate(std::size_t bytes) noexcept {
+        return buddy_malloc(allocator_, bytes);
+    }
+
+    void deallocate(void *ptr, std::size_t) noexcept {
+        buddy_free(allocator_, ptr);
+    }
+
+private:
+    alignas(std::max_align_t) std::array<unsigned char, metadata_size> metadata_;
+    alignas(Align) std::array<unsigned char, size> memory_;
+    struct buddy *allocator_;
+};
+
+template <std::size_t Order, std::size_t Align>
+constexpr std::size_t arena<Order, Align>::order;
+
+template <std::size_t Order, std::size_t Align>
+constexpr std::size_t arena<Order, Align>::alignment;
+
+template <std::size_t Order, std::size_t Align>
+constexpr std::size_t arena<Order, Align>::size;
+
+template <std::size_t Order, std::size_t Align>
+constexpr std::size_t arena<Order, Align>::metadata_size;
+
+/*
+ * Owns the storage of an allocator and its arena, allocated with new[]. The arena is aligned
+ * to the allocator alignment, BUDDY_ALLOC_ALIGN unless given. In standard mode the metadata
+ * is stored separately, in embedded mode it is placed at the end of the arena.
+ * Throws std::bad_alloc if the allocator cannot be initialized. The allocator does not move
+ * with the handle. Do not resize an embedded allocator as that can relocate it.
+ */
+class unique_arena {
+public:
+    enum class mode {
+        standard,
+        embedded
+    };
+
+    explicit unique_arena(std::size_t size, mode kind = mode::standard)
+        : unique_arena(size, BUDDY_ALLOC_ALIGN, kind) {}
+
+    unique_arena(std::size_t size, std::size_t alignment, mode kind = mode::standard)
+        : memory_(), metadata_(), data_(nullptr), allocator_(nullptr) {
+        /* new[] only aligns for the fundamental types, over-allocate and align within */
+        std::size_t align = (alignment > BUDDY_ALLOC_ALIGN) ? alignment : BUDDY_ALLOC_ALIGN;
+        std::size_t space;
+        void *start;
+        /* The allocator rejects alignments that are not powers of two */
+        if (((align & (align - 1)) != 0) || (size > (std::numeric_limits<std::size_t>::max() - align))) {
+            throw std::bad_alloc();
+        }
+        space = size + align - 1;
+        memory_.reset(new unsigned char[space]);
+        start = memory_.get();
+        data_ = static_cast<unsigned char *>(std::align(align, size, start, space));
+        if (kind == mode::embedded) {
+            allocator_ = buddy_embed_alignment(data_, size, alignment);
+        } else if (buddy_sizeof_alignment(size, alignment) != 0) {
+            metadata_.reset(new unsigned char[buddy_sizeof_alignment(size, alignment)]);
+            allocator_ = buddy_init_alignment(metadata_.get(), data_, size, alignment);
+        }
+        if (allocator_ == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+
+    unique_arena(unique_arena &&other) noexcept
+        : memory_(std::move(other.memory_)), metadata_(std::move(other.metadata_)), data_(other.data_),
+        allocator_(other.allocator_) {
+        other.data_ = nullptr;
+        other.allocator_ = nullptr;
+    }
+
+    unique_arena &operator=(unique_arena &&other) noexcept {
+        memory_ = std::move(other.memory_);
+        metadata_ = std::move(other.metadata_);
+        data_ = other.data_;
+        allocator_ = other.allocator_;
+        other.data_ = nullptr;
+        other.allocator_ = nullptr;
+        return *this;
+    }
+
+    struct buddy *get() const noexcept {
+        return allocator_;
+    }
+
+    unsigned char *data() const noexcept {
+        return data_;
+    }
+
+private:
+    std::unique_ptr<unsigned char[]> memory_;
+    std::unique_ptr<unsigned char[]> metadata_;
+    unsigned char *data_;
+    struct buddy *allocator_;
+};
+
+/* Destroys an object and returns its memory to the allocator that it came from */
+template <typename T>
+class deleter {
+public:
+    deleter() noexcept : allocator_(nullptr) {}
+
+    explicit deleter(struct buddy *instance) noexcept : allocator_(instance) {}
+
+    struct buddy *get() const noexcept {
+        return allocator_;
+    }
+
+    void operator()(T *ptr) const noexcept {
+        ptr->~T();
+        buddy_free(allocator_, ptr);
+    }
+
+private:
+    struct buddy *allocator_;
+};
+
+/* Destroys an array of objects and returns its memory to the allocator that it came from */
+template <typename T>
+class deleter<T[]> {
+public:
+    deleter() noexcept : allocator_(nullptr), count_(0) {}
+
+    deleter(struct buddy *instance, std::size_t count) noexcept : allocator_(instance), count_(count) {}
+
+    struct buddy *get() const noexcept {
+        return allocator_;
+    }
+
+    std::size_t size() const noexcept {
+        return count_;
+    }
+
+    void operator()(T *ptr) const noexcept {
+        for (std::size_t i = count_; i; i--) {
+            ptr[i - 1].~T();
+        }
+        buddy_free(allocator_, ptr);
+    }
+
+private:
+    struct buddy *allocator_;
+    std::size_t count_;
+};
+
+/* A std::unique_ptr for objects allocated from a buddy allocator */
+template <typename T>
+using unique_ptr = std::unique_ptr<T, deleter<T> >;
+
+namespace detail {
+
+/* Constructs the elements of an array, value-initialized or default-initialized */
+template <typename T, bool Value>
+unique_ptr<T[]> make_array(struct buddy *instance, std::size_t n) {
+    std::size_t constructed = 0;
+    T *objects;
+    if (n > (std::numeric_limits<std::size_t>::max() / sizeof(T))) {
+        throw std::bad_alloc();
+    }
+    objects = static_cast<T *>(allocate(instance, n * sizeof(T), alignof(T)));
+    try {
+        for (; constructed < n; constructed++) {
+            if (Value) {
+                ::new (static_cast<void *>(objects + constructed)) T();
+            } else {
+                ::new (static_cast<void *>(objects + constructed)) T;
+            }
+        }
+    } catch (...) {
+        while (constructed) {
+            objects[--constructed].~T();
+        }
+        buddy_free(instance, objects);
+        throw;
+    }
+    return unique_ptr<T[]>(objects, deleter<T[]>(instance, n));
+}
+
+} /* namespace detail */
+
+/*
+ * Allocates and constructs an object from a buddy allocator, see std::make_unique.
+ * Throws std::bad_alloc if the allocator is exhausted.
+ */
+template <typename T, typename... Args>
+typename std::enable_if<! std::is_array<T>::value, unique_ptr<T> >::type
+make_unique(struct buddy *instance, Args &&...args) {
+    void *memory = detail::allocate(instance, sizeof(T), alignof(T));
+    T *object;
+    try {
+        object = ::new (memory) T(std::forward<Args>(args)...);
+    } catch (...) {
+        buddy_free(instance, memory);
+        throw;
+    }
+    return unique_ptr<T>(object, deleter<T>(instance));
+}
+
+/* Allocates an array of n value-initialized objects from a buddy allocator */
+template <typename T>
+typename std::enable_if<std::is_array<T>::value && (std::extent<T>::value == 0), unique_ptr<T> >::type
+make_unique(struct buddy *instance, std::size_t n) {
+    return detail::make_array<typename std::remove_extent<T>::type, true>(instance, n);
+}
+
+template <typename T, typename... Args>
+typename std::enable_if<(std::extent<T>::value != 0)>::type
+make_unique(struct buddy *, Args &&...) = delete;
+
+/*
+ * Allocates a default-initialized object from a buddy allocator, see std::make_unique_for_overwrite.
+ * Objects of trivial types are left uninitialized and the memory is not zeroed.
+ */
+template <typename T>
+typename std::enable_if<! std::is_array<T>::value, unique_ptr<T> >::type
+make_unique_for_overwrite(struct buddy *instance) {
+    void *memory = detail::allocate(instance, sizeof(T), alignof(T));
+    T *object;
+    try {
+        object = ::new (memory) T;
+    } catch (...) {
+        buddy_free(instance, memory);
+        throw;
+    }
+    return unique_ptr<T>(object, deleter<T>(instance));
+}
+
+/* Allocates an array of n default-initialized objects from a buddy allocator */
+template <typename T>
+typename std::enable_if<std::is_array<T>::value && (std::extent<T>::value == 0), unique_ptr<T> >::type
+make_unique_for_overwrite(struct buddy *instance, std::size_t n) {
+    return detail::make_array<typename std::remove_extent<T>::type, false>(instance, n);
+}
+
+template <typename T, typename... Args>
+typename std::enable_if<(std::extent<T>::value != 0)>::type
+make_unique_for_overwrite(struct buddy *, Args &&...) = delete;
+
+#if defined(__cpp_lib_memory_resource)
+/*
+ * A std::pmr::memory_resource that allocates from a buddy allocator.
+ *
+ * Requests are rounded up to their alignment, which places them in a slot that is
+ * aligned to its size within the arena. Two resources compare equal only if they share
+ * an allocator.
+ */
+class memory_resource : public std::pmr::memory_resource {
+public:
+    explicit memory_resource(struct buddy *instance) noexcept : allocator_(instance) {}
+
+    struct buddy *get() const noexcept {
+        return allocator_;
+    }
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        return detail::allocate(allocator_, (bytes < alignment) ? alignment : bytes, alignment);
+    }
+
+    void do_deallocate(void *ptr, std::size_t, std::size_t) override {
+        buddy_free(allocator_, ptr);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        const memory_resource *that = dynamic_cast<const memory_resource *>(&other);
+        return (that != nullptr) && (that->allocator_ == allocator_);
+    }
+
+private:
+    struct buddy *allocator_;
+};
+#endif /* defined(__cpp_lib_memory_resource) */
+
+#if defined(__cpp_impl_coroutine)
+/*
+ * Binds a buddy allocator to the current thread for coroutine frames while the object lives.
+ *
+ * Bindings nest and the previous one is restored on destruction. Frames allocated without a
+ * binding come from the global heap. Every frame remembers where it came from, so it can be
+ * destroyed after the binding ends or on another thread, as long as the allocator is not used
+ * concurrently. Exhaustion is reported with std::bad_alloc.
+ */
+class coroutine_allocator {
+public:
+    explicit coroutine_allocator(struct buddy *instance) noexcept : previous_(binding()) {
+        binding() = instance;
+    }
+
+    ~coroutine_allocator() {
+        binding() = previous_;
+    }
+
+    coroutine_allocator(const coroutine_allocator &) = delete;
+    coroutine_allocator &operator=(const coroutine_allocator &) = delete;
+
+    /* Returns the allocator bound to the current thread or nullptr */
+    static struct buddy *get() noexcept {
+        return binding();
+    }
+
+    static void *allocate(std::size_t size) {
+        struct buddy *instance = binding();
+        unsigned char *block;
+        if (size > (std::numeric_limits<std::size_t>::max() - header)) {
+            throw std::bad_alloc();
+        }
+        if (instance == nullptr) {
+            block = static_cast<unsigned char *>(::operator new(size + header));
+        } else {
+            block = static_cast<unsigned char *>(detail::allocate(instance, size + header, header));
+        }
+        std::memcpy(block, &instance, sizeof(instance));
+        return block + header;
+    }
+
+    static void deallocate(void *frame, std::size_t size) noexcept {
+        unsigned char *block = static_cast<unsigned char *>(frame) - header;
+        struct buddy *instance;
+        std::memcpy(&instance, block, sizeof(instance));
+        if (instance == nullptr) {
+            ::operator delete(block, size + header);
+        } else {
+            buddy_free(instance, block);
+        }
+    }
+
+private:
+    /* The frame is preceded by its allocator, padded to keep the frame aligned */
+    static constexpr std::size_t header = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    static struct buddy *&binding() noexcept {
+        static thread_local struct buddy *instance = nullptr;
+        return instance;
+    }
+
+    struct buddy *previous_;
+};
+
+/*
+ * A base for coroutine promise types that allocates their frames with coroutine_allocator.
+ * The frame size is passed back on deallocation.
+ */
+struct promise_base {
+    static void *operator new(std::size_t size) {
+        return coroutine_allocator::allocate(size);
+    }
+
+    static void operator delete(void *frame, std::size_t size) noexcept {
+        coroutine_allocator::deallocate(frame, size);
+    }
+};
+#endif /* defined(__cpp_impl_coroutine) */
+
+} /* namespace buddy_alloc */
+
+#endif /* BUDDY_ALLOC_HPP */
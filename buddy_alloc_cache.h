@@ -0,0 +1,400 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ *
+ * An object cache on top of the binary buddy memory allocator
+ *
+ * Keeps objects of a fixed size in their constructed state between uses so that
+ * the cost of constructing and destroying them is paid once per slab instead of
+ * once per allocation. Objects are carved from slabs allocated by the buddy
+ * allocator and freed objects are kept in magazines, arrays of object pointers
+ * that are exchanged whole with a depot of full and empty magazines.
+ *
+ * A cache is not thread-safe, create one per thread or guard it externally.
+ *
+ * To include and use it in your project do the following
+ * 1. Add buddy_alloc.h and buddy_alloc_cache.h (this file) to your include directory
+ * 2. Include the header in places where you need to use the cache
+ * 3. In one of your source files #define BUDDY_ALLOC_IMPLEMENTATION
+ *    and BUDDY_ALLOC_CACHE_IMPLEMENTATION and then import the header.
+ *    This will insert the implementation.
+ *
+ * Latest version is available at https://github.com/spaskalev/buddy_alloc
+ */
+
+#ifndef BUDDY_ALLOC_CACHE_H
+#define BUDDY_ALLOC_CACHE_H
+
+#ifndef BUDDY_HEADER
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "buddy_alloc.h"
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+extern "C" {
+#endif
+#endif
+
+/* Objects held by a magazine */
+#ifndef BUDDY_CACHE_MAGAZINE_SIZE
+#define BUDDY_CACHE_MAGAZINE_SIZE 14
+#endif
+
+/* The smallest slab size, slabs hold at least eight objects */
+#ifndef BUDDY_CACHE_SLAB_SIZE
+#define BUDDY_CACHE_SLAB_SIZE 4096
+#endif
+
+/* The alignment of cached objects, as for malloc. A power of two, at least the size of a pointer */
+#ifndef BUDDY_CACHE_ALIGN
+#define BUDDY_CACHE_ALIGN 16
+#endif
+
+struct buddy_cache;
+
+/*
+ * Creates a cache of objects of the given size that allocates from the buddy allocator.
+ *
+ * The constructor is called for every object when its slab is allocated and the
+ * destructor when the slab is released. Either can be NULL. Objects must be returned
+ * to the cache in their constructed state. Objects are aligned to BUDDY_CACHE_ALIGN
+ * if the arena of the allocator is.
+ *
+ * Returns NULL on failure.
+ */
+struct buddy_cache *buddy_cache_create(struct buddy *buddy, size_t object_size,
+    void (*ctor)(void *object), void (*dtor)(void *object));
+
+/* Returns a constructed object or NULL if the allocator is out of memory. */
+void *buddy_cache_alloc(struct buddy_cache *cache);
+
+/* Returns an object to the cache. A NULL object is ignored. */
+void buddy_cache_free(struct buddy_cache *cache, void *object);
+
+/*
+ * Destroys the objects held by the depot and returns unused magazines and
+ * slabs without allocated objects to the buddy allocator.
+ */
+void buddy_cache_reap(struct buddy_cache *cache);
+
+/*
+ * Destroys all cached objects and releases the cache.
+ * Every object must be returned to the cache beforehand.
+ */
+void buddy_cache_destroy(struct buddy_cache *cache);
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+}
+#endif
+#endif
+
+#endif /* BUDDY_ALLOC_CACHE_H */
+
+#ifdef BUDDY_ALLOC_CACHE_IMPLEMENTATION
+#undef BUDDY_ALLOC_CACHE_IMPLEMENTATION
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+extern "C" {
+#endif
+#endif
+
+struct buddy_cache_magazine {
+    struct buddy_cache_magazine *next;
+    size_t rounds;
+    void *objects[BUDDY_CACHE_MAGAZINE_SIZE];
+};
+
+/*
+ * Every object is followed by a link word. It points to the slab of the object
+ * while the object is allocated or in a magazine and to the next free object
+ * while the object is free in its slab.
+ */
+struct buddy_cache_slab {
+    struct buddy_cache_slab *prev; /* slabs with free objects */
+    struct buddy_cache_slab *next;
+    void *free;
+    size_t used;
+};
+
+/* The objects of a slab start after its header, rounded up to the object alignment */
+#define BUDDY_CACHE_SLAB_HEADER \
+    (((sizeof(struct buddy_cache_slab) + BUDDY_CACHE_ALIGN - 1) / BUDDY_CACHE_ALIGN) * BUDDY_CACHE_ALIGN)
+
+struct buddy_cache {
+    struct buddy *buddy;
+    size_t slot_size; /* object and link word */
+    size_t slab_size;
+    size_t capacity; /* objects per slab */
+    void (*ctor)(void *object);
+    void (*dtor)(void *object);
+    struct buddy_cache_magazine *loaded;
+    struct buddy_cache_magazine *previous;
+    struct buddy_cache_magazine *full; /* the depot */
+    struct buddy_cache_magazine *empty;
+    struct buddy_cache_slab *partial;
+};
+
+static unsigned char *buddy_cache_object(struct buddy_cache *cache, struct buddy_cache_slab *slab, size_t index);
+static void **buddy_cache_link(struct buddy_cache *cache, void *object);
+static struct buddy_cache_magazine *buddy_cache_empty_magazine(struct buddy_cache *cache);
+static void buddy_cache_flush(struct buddy_cache *cache, struct buddy_cache_magazine *magazine);
+static void *buddy_cache_slab_alloc(struct buddy_cache *cache);
+static void buddy_cache_slab_free(struct buddy_cache *cache, void *object);
+static void buddy_cache_slab_unlink(struct buddy_cache *cache, struct buddy_cache_slab *slab);
+static void buddy_cache_slab_destroy(struct buddy_cache *cache, struct buddy_cache_slab *slab);
+
+struct buddy_cache *buddy_cache_create(struct buddy *buddy, size_t object_size,
+        void (*ctor)(void *object), void (*dtor)(void *object)) {
+    struct buddy_cache *cache;
+    size_t slot_size, slab_size;
+
+    if ((buddy == NULL) || (object_size == 0) || (object_size > (SIZE_MAX / 32))) {
+        return NULL;
+    }
+    /* Slots are a multiple of the object alignment, with the link word at their end */
+    slot_size = object_size + sizeof(void *);
+    slot_size = ((slot_size + BUDDY_CACHE_ALIGN - 1) / BUDDY_CACHE_ALIGN) * BUDDY_CACHE_ALIGN;
+    slab_size = BUDDY_CACHE_SLAB_SIZE;
+    while (slab_size < (BUDDY_CACHE_SLAB_HEADER + (8 * slot_size))) {
+        slab_size *= 2;
+    }
+
+    cache = (struct buddy_cache *) buddy_malloc(buddy, sizeof(*cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->buddy = buddy;
+    cache->slot_size = slot_size;
+    cache->slab_size = slab_size;
+    cache->capacity = (slab_size - BUDDY_CACHE_SLAB_HEADER) / slot_size;
+    cache->ctor = ctor;
+    cache->dtor = dtor;
+    cache->full = NULL;
+    cache->empty = NULL;
+    cache->partial = NULL;
+    cache->loaded = buddy_cache_empty_magazine(cache);
+    cache->previous = buddy_cache_empty_magazine(cache);
+    if ((cache->loaded == NULL) || (cache->previous == NULL)) {
+        buddy_free(buddy, cache->loaded);
+        buddy_free(buddy, cache->previous);
+        buddy_free(buddy, cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void *buddy_cache_alloc(struct buddy_cache *cache) {
+    struct buddy_cache_magazine *magazine;
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    if (cache->loaded->rounds == 0) {
+        if (cache->previous->rounds) {
+            magazine = cache->loaded;
+            cache->loaded = cache->previous;
+            cache->previous = magazine;
+        } else if (cache->full) {
+            /* Exchange the empty previous magazine for a full one from the depot */
+            magazine = cache->full;
+            cache->full = magazine->next;
+            cache->previous->next = cache->empty;
+            cache->empty = cache->previous;
+            cache->previous = cache->loaded;
+            cache->loaded = magazine;
+        } else {
+            return buddy_cache_slab_alloc(cache);
+        }
+    }
+    cache->loaded->rounds--;
+    return cache->loaded->objects[cache->loaded->rounds];
+}
+
+void buddy_cache_free(struct buddy_cache *cache, void *object) {
+    struct buddy_cache_magazine *magazine;
+
+    if ((cache == NULL) || (object == NULL)) {
+        return;
+    }
+    if (cache->loaded->rounds == BUDDY_CACHE_MAGAZINE_SIZE) {
+        if (cache->previous->rounds == 0) {
+            magazine = cache->loaded;
+            cache->loaded = cache->previous;
+            cache->previous = magazine;
+        } else {
+            /* Exchange the full previous magazine for an empty one from the depot */
+            magazine = buddy_cache_empty_magazine(cache);
+            if (magazine == NULL) {
+                buddy_cache_slab_free(cache, object);
+                return;
+            }
+            cache->previous->next = cache->full;
+            cache->full = cache->previous;
+            cache->previous = cache->loaded;
+            cache->loaded = magazine;
+        }
+    }
+    cache->loaded->objects[cache->loaded->rounds] = object;
+    cache->loaded->rounds++;
+}
+
+void buddy_cache_reap(struct buddy_cache *cache) {
+    struct buddy_cache_magazine *magazine;
+    struct buddy_cache_slab *slab, *next;
+
+    if (cache == NULL) {
+        return;
+    }
+    while (cache->full) {
+        magazine = cache->full;
+        cache->full = magazine->next;
+        buddy_cache_flush(cache, magazine);
+        buddy_free(cache->buddy, magazine);
+    }
+    while (cache->empty) {
+        magazine = cache->empty;
+        cache->empty = magazine->next;
+        buddy_free(cache->buddy, magazine);
+    }
+    slab = cache->partial;
+    while (slab) {
+        next = slab->next;
+        if (slab->used == 0) {
+            buddy_cache_slab_unlink(cache, slab);
+            buddy_cache_slab_destroy(cache, slab);
+        }
+        slab = next;
+    }
+}
+
+void buddy_cache_destroy(struct buddy_cache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    buddy_cache_flush(cache, cache->loaded);
+    buddy_cache_flush(cache, cache->previous);
+    buddy_cache_reap(cache);
+    buddy_free(cache->buddy, cache->loaded);
+    buddy_free(cache->buddy, cache->previous);
+    buddy_free(cache->buddy, cache);
+}
+
+static unsigned char *buddy_cache_object(struct buddy_cache *cache, struct buddy_cache_slab *slab, size_t index) {
+    return (unsigned char *) slab + BUDDY_CACHE_SLAB_HEADER + (index * cache->slot_size);
+}
+
+static void **buddy_cache_link(struct buddy_cache *cache, void *object) {
+    return (void **) ((unsigned char *) object + cache->slot_size - sizeof(void *));
+}
+
+static struct buddy_cache_magazine *buddy_cache_empty_magazine(struct buddy_cache *cache) {
+    struct buddy_cache_magazine *magazine = cache->empty;
+
+    if (magazine) {
+        cache->empty = magazine->next;
+    } else {
+        magazine = (struct buddy_cache_magazine *) buddy_malloc(cache->buddy, sizeof(*magazine));
+        if (magazine == NULL) {
+            return NULL;
+        }
+    }
+    magazine->next = NULL;
+    magazine->rounds = 0;
+    return magazine;
+}
+
+static void buddy_cache_flush(struct buddy_cache *cache, struct buddy_cache_magazine *magazine) {
+    while (magazine->rounds) {
+        magazine->rounds--;
+        buddy_cache_slab_free(cache, magazine->objects[magazine->rounds]);
+    }
+}
+
+static void *buddy_cache_slab_alloc(struct buddy_cache *cache) {
+    struct buddy_cache_slab *slab = cache->partial;
+    unsigned char *object;
+    size_t i;
+
+    if (slab == NULL) {
+        slab = (struct buddy_cache_slab *) buddy_malloc(cache->buddy, cache->slab_size);
+        if (slab == NULL) {
+            return NULL;
+        }
+        slab->prev = NULL;
+        slab->next = NULL;
+        slab->free = NULL;
+        slab->used = 0;
+        /* Construct every object of the slab once, keeping the free list in address order */
+        for (i = cache->capacity; i; i--) {
+            object = buddy_cache_object(cache, slab, i - 1);
+            if (cache->ctor) {
+                cache->ctor(object);
+            }
+            *buddy_cache_link(cache, object) = slab->free;
+            slab->free = object;
+        }
+        cache->partial = slab;
+    }
+
+    object = (unsigned char *) slab->free;
+    slab->free = *buddy_cache_link(cache, object);
+    *buddy_cache_link(cache, object) = slab;
+    slab->used++;
+    if (slab->free == NULL) {
+        buddy_cache_slab_unlink(cache, slab);
+    }
+    return object;
+}
+
+static void buddy_cache_slab_free(struct buddy_cache *cache, void *object) {
+    struct buddy_cache_slab *slab = (struct buddy_cache_slab *) *buddy_cache_link(cache, object);
+
+    /* A full slab has free objects again */
+    if (slab->free == NULL) {
+        slab->prev = NULL;
+        slab->next = cache->partial;
+        if (slab->next) {
+            slab->next->prev = slab;
+        }
+        cache->partial = slab;
+    }
+    *buddy_cache_link(cache, object) = slab->free;
+    slab->free = object;
+    slab->used--;
+}
+
+static void buddy_cache_slab_unlink(struct buddy_cache *cache, struct buddy_cache_slab *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        cache->partial = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+static void buddy_cache_slab_destroy(struct buddy_cache *cache, struct buddy_cache_slab *slab) {
+    size_t i;
+
+    if (cache->dtor) {
+        for (i = 0; i < cache->capacity; i++) {
+            cache->dtor(buddy_cache_object(cache, slab, i));
+        }
+    }
+    buddy_free(cache->buddy, slab);
+}
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+}
+#endif
+#endif
+
+#endif /* BUDDY_ALLOC_CACHE_IMPLEMENTATION */
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ *
+ * A pool of page-aligned I/O buffers on top of the binary buddy memory allocator (POSIX)
+ *
+ * Manages an anonymous mapping with a buddy allocator whose alignment is the system
+ * page size. Buffers are page-aligned blocks of power-of-two sizes, suitable for
+ * direct I/O with O_DIRECT. The mapping can be pre-faulted and locked in memory when
+ * the pool is created so that I/O does not pay for page faults.
+ *
+ * To include and use it in your project do the following
+ * 1. Add buddy_alloc.h and buddy_alloc_iobuf.h (this file) to your include directory
+ * 2. Include the header in places where you need to use the pool
+ * 3. In one of your source files #define BUDDY_ALLOC_IMPLEMENTATION
+ *    and BUDDY_ALLOC_IOBUF_IMPLEMENTATION and then import the header.
+ *    This will insert the implementation.
+ * 4. Link with -lpthread
+ *
+ * Latest version is available at https://github.com/spaskalev/buddy_alloc
+ */
+
+#ifndef BUDDY_ALLOC_IOBUF_H
+#define BUDDY_ALLOC_IOBUF_H
+
+#ifndef BUDDY_HEADER
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "buddy_alloc.h"
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+extern "C" {
+#endif
+#endif
+
+/* Pool creation flags */
+#define BUDDY_IOBUF_PREFAULT 0x1 /* populate the whole arena up front */
+#define BUDDY_IOBUF_LOCK 0x2 /* lock the whole arena in memory, implies pre-faulting */
+
+struct buddy_iobuf_pool;
+
+/*
+ * Creates a pool that manages an arena of the specified size. The arena is rounded
+ * up to a power of two multiple of the page size.
+ *
+ * Returns NULL on failure, including when the arena cannot be pre-faulted or locked.
+ */
+struct buddy_iobuf_pool *buddy_iobuf_create(size_t arena_size, unsigned int flags);
+
+/* Unmaps the pool and all of its buffers. */
+void buddy_iobuf_destroy(struct buddy_iobuf_pool *pool);
+
+/*
+ * Returns a page-aligned buffer of at least the requested size or NULL if there is
+ * no free block for it. The buffer size is the requested size rounded up to a power
+ * of two that is at least a page, see buddy_iobuf_size.
+ */
+void *buddy_iobuf_get(struct buddy_iobuf_pool *pool, size_t requested_size);
+
+/* Returns a buffer to the pool. A NULL buffer is ignored. */
+void buddy_iobuf_put(struct buddy_iobuf_pool *pool, void *buffer);
+
+/* Returns the size of a buffer or zero if it is not a buffer of the pool. */
+size_t buddy_iobuf_size(struct buddy_iobuf_pool *pool, void *buffer);
+
+/* Returns the size of the blocks that buffers are made of, the system page size. */
+size_t buddy_iobuf_page_size(struct buddy_iobuf_pool *pool);
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+}
+#endif
+#endif
+
+#endif /* BUDDY_ALLOC_IOBUF_H */
+
+#ifdef BUDDY_ALLOC_IOBUF_IMPLEMENTATION
+#undef BUDDY_ALLOC_IOBUF_IMPLEMENTATION
+
+#ifndef BUDDY_HEADER
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+extern "C" {
+#endif
+#endif
+
+struct buddy_iobuf_pool {
+    pthread_mutex_t lock;
+    struct buddy *buddy;
+    unsigned char *arena;
+    size_t page_size;
+    size_t mapping_size; /* the header, the allocator metadata and the arena */
+};
+
+struct buddy_iobuf_pool *buddy_iobuf_create(size_t arena_size, unsigned int flags) {
+    struct buddy_iobuf_pool *pool;
+    size_t page_size, size, header_size, metadata_size, mapping_size;
+    long sysconf_page_size;
+    int mmap_flags;
+    void *region;
+
+    sysconf_page_size = sysconf(_SC_PAGESIZE);
+    if (sysconf_page_size <= 0) {
+        return NULL;
+    }
+    page_size = (size_t) sysconf_page_size;
+    if ((arena_size == 0) || (arena_size > (SIZE_MAX / 4))) {
+        return NULL;
+    }
+    /* A power of two arena has no virtual slots to waste on an unaligned tail */
+    size = page_size;
+    while (size < arena_size) {
+        size *= 2;
+    }
+    arena_size = size;
+
+    metadata_size = buddy_sizeof_alignment(arena_size, page_size);
+    if (metadata_size == 0) {
+        return NULL;
+    }
+    header_size = sizeof(struct buddy_iobuf_pool) + metadata_size;
+    header_size = ((header_size + page_size - 1) / page_size) * page_size;
+    mapping_size = header_size + arena_size;
+
+    mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+    if (flags & (BUDDY_IOBUF_PREFAULT | BUDDY_IOBUF_LOCK)) {
+        mmap_flags |= MAP_POPULATE;
+    }
+#endif
+    region = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    pool = (struct buddy_iobuf_pool *) region;
+    pool->arena = (unsigned char *) region + header_size;
+    pool->page_size = page_size;
+    pool->mapping_size = mapping_size;
+
+#ifndef MAP_POPULATE
+    /* Touch every page where the mapping cannot be populated */
+    if (flags & (BUDDY_IOBUF_PREFAULT | BUDDY_IOBUF_LOCK)) {
+        size_t offset;
+        for (offset = 0; offset < arena_size; offset += page_size) {
+            pool->arena[offset] = 0;
+        }
+    }
+#endif
+    if ((flags & BUDDY_IOBUF_LOCK) && (mlock(pool->arena, arena_size) != 0)) {
+        munmap(region, mapping_size);
+        return NULL;
+    }
+
+    pool->buddy = buddy_init_alignment((unsigned char *) (pool + 1), pool->arena, arena_size, page_size);
+    if ((pool->buddy == NULL) || (pthread_mutex_init(&pool->lock, NULL) != 0)) {
+        munmap(region, mapping_size);
+        return NULL;
+    }
+    return pool;
+}
+
+void buddy_iobuf_destroy(struct buddy_iobuf_pool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&pool->lock);
+    /* Unmapping also unlocks the arena */
+    munmap(pool, pool->mapping_size);
+}
+
+void *buddy_iobuf_get(struct buddy_iobuf_pool *pool, size_t requested_size) {
+    void *result;
+
+    if ((pool == NULL) || (requested_size == 0)) {
+        return NULL;
+    }
+    pthread_mutex_lock(&pool->lock);
+    result = buddy_malloc(pool->buddy, requested_size);
+    pthread_mutex_unlock(&pool->lock);
+    return result;
+}
+
+void buddy_iobuf_put(struct buddy_iobuf_pool *pool, void *buffer) {
+    if ((pool == NULL) || (buffer == NULL)) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    buddy_free(pool->buddy, buffer);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+size_t buddy_iobuf_size(struct buddy_iobuf_pool *pool, void *buffer) {
+    size_t result;
+
+    if (pool == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&pool->lock);
+    result = buddy_usable_size(pool->buddy, buffer);
+    pthread_mutex_unlock(&pool->lock);
+    return result;
+}
+
+size_t buddy_iobuf_page_size(struct buddy_iobuf_pool *pool) {
+    if (pool == NULL) {
+        return 0;
+    }
+    return pool->page_size;
+}
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+}
+#endif
+#endif
+
+#endif /* BUDDY_ALLOC_IOBUF_IMPLEMENTATION */
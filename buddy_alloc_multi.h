@@ -0,0 +1,243 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ *
+ * A size-class router over several binary buddy memory allocators
+ *
+ * Owns a small, a medium and a large allocator with alignments of 16 bytes,
+ * 256 bytes and 4 KB. Requests are routed by size so that small objects do
+ * not waste memory on a coarse alignment and large arenas do not pay for the
+ * metadata of a fine one. Memory is freed through a single entry point that
+ * finds the owning allocator by address.
+ *
+ * To include and use it in your project do the following
+ * 1. Add buddy_alloc.h and buddy_alloc_multi.h (this file) to your include directory
+ * 2. Include the header in places where you need to use the allocator
+ * 3. In one of your source files #define BUDDY_ALLOC_IMPLEMENTATION
+ *    and BUDDY_ALLOC_MULTI_IMPLEMENTATION and then import the header.
+ *    This will insert the implementation.
+ *
+ * Latest version is available at https://github.com/spaskalev/buddy_alloc
+ */
+
+#ifndef BUDDY_ALLOC_MULTI_H
+#define BUDDY_ALLOC_MULTI_H
+
+#ifndef BUDDY_HEADER
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "buddy_alloc.h"
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+extern "C" {
+#endif
+#endif
+
+/* Alignments of the small, medium and large allocators */
+#define BUDDY_MULTI_SMALL_ALIGN 16
+#define BUDDY_MULTI_MEDIUM_ALIGN 256
+#define BUDDY_MULTI_LARGE_ALIGN 4096
+
+struct buddy_multi;
+
+/*
+ * Returns the size of the metadata of a router with arenas of the given sizes
+ * or zero if none of them can hold an allocator. An arena size of zero leaves
+ * out its size class.
+ */
+size_t buddy_multi_sizeof(size_t small_size, size_t medium_size, size_t large_size);
+
+/*
+ * Returns the size of the memory block that holds arenas of the given sizes.
+ * The arenas are placed one after the other, each aligned to the alignment of its
+ * allocator relative to the start of the block.
+ */
+size_t buddy_multi_arena_size(size_t small_size, size_t medium_size, size_t large_size);
+
+/*
+ * Initializes a router at the specified location, with buddy_multi_sizeof bytes,
+ * to manage the main block of buddy_multi_arena_size bytes. Align the main block
+ * to BUDDY_MULTI_LARGE_ALIGN for allocations aligned to their allocator's alignment.
+ *
+ * Returns NULL on failure.
+ */
+struct buddy_multi *buddy_multi_init(unsigned char *at, unsigned char *main,
+    size_t small_size, size_t medium_size, size_t large_size);
+
+/*
+ * Allocates from the smallest size class that suits the request. Requests of a
+ * class that is left out or exhausted are served by the larger classes.
+ */
+void *buddy_multi_malloc(struct buddy_multi *multi, size_t requested_size);
+
+/* Frees memory allocated by buddy_multi_malloc. Addresses outside of the arenas are ignored. */
+void buddy_multi_free(struct buddy_multi *multi, void *ptr);
+
+/* Returns the allocator that owns the address or NULL */
+struct buddy *buddy_multi_buddy(struct buddy_multi *multi, void *ptr);
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+}
+#endif
+#endif
+
+#endif /* BUDDY_ALLOC_MULTI_H */
+
+#ifdef BUDDY_ALLOC_MULTI_IMPLEMENTATION
+#undef BUDDY_ALLOC_MULTI_IMPLEMENTATION
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+extern "C" {
+#endif
+#endif
+
+#define BUDDY_MULTI_CLASSES 3
+
+struct buddy_multi {
+    struct buddy *buddies[BUDDY_MULTI_CLASSES];
+    unsigned char *start[BUDDY_MULTI_CLASSES];
+    unsigned char *end[BUDDY_MULTI_CLASSES];
+};
+
+struct buddy_multi_layout {
+    size_t sizes[BUDDY_MULTI_CLASSES];
+    size_t metadata[BUDDY_MULTI_CLASSES]; /* offsets in the metadata block */
+    size_t arenas[BUDDY_MULTI_CLASSES]; /* offsets in the main block */
+    size_t metadata_size;
+    size_t arena_size;
+};
+
+static const size_t buddy_multi_alignments[BUDDY_MULTI_CLASSES] = {
+    BUDDY_MULTI_SMALL_ALIGN, BUDDY_MULTI_MEDIUM_ALIGN, BUDDY_MULTI_LARGE_ALIGN
+};
+
+static struct buddy_multi_layout buddy_multi_layout(size_t small_size, size_t medium_size, size_t large_size);
+static size_t buddy_multi_round_up(size_t value, size_t alignment);
+
+size_t buddy_multi_sizeof(size_t small_size, size_t medium_size, size_t large_size) {
+    return buddy_multi_layout(small_size, medium_size, large_size).metadata_size;
+}
+
+size_t buddy_multi_arena_size(size_t small_size, size_t medium_size, size_t large_size) {
+    return buddy_multi_layout(small_size, medium_size, large_size).arena_size;
+}
+
+struct buddy_multi *buddy_multi_init(unsigned char *at, unsigned char *main,
+        size_t small_size, size_t medium_size, size_t large_size) {
+    struct buddy_multi_layout layout = buddy_multi_layout(small_size, medium_size, large_size);
+    struct buddy_multi *multi;
+    size_t i;
+
+    if ((at == NULL) || (main == NULL) || (layout.metadata_size == 0)) {
+        return NULL;
+    }
+    if (((uintptr_t) at) % sizeof(size_t)) {
+        return NULL;
+    }
+    multi = (struct buddy_multi *) at;
+    for (i = 0; i < BUDDY_MULTI_CLASSES; i++) {
+        multi->buddies[i] = NULL;
+        multi->start[i] = main + layout.arenas[i];
+        multi->end[i] = multi->start[i];
+        if (layout.sizes[i] == 0) {
+            continue;
+        }
+        multi->buddies[i] = buddy_init_alignment(at + layout.metadata[i], multi->start[i],
+            layout.sizes[i], buddy_multi_alignments[i]);
+        if (multi->buddies[i] == NULL) {
+            return NULL;
+        }
+        multi->end[i] = multi->start[i] + layout.sizes[i];
+    }
+    return multi;
+}
+
+void *buddy_multi_malloc(struct buddy_multi *multi, size_t requested_size) {
+    void *result;
+    size_t i;
+
+    if (multi == NULL) {
+        return NULL;
+    }
+    /* Start at the smallest class whose successor's alignment exceeds the request */
+    i = 0;
+    while ((i < (BUDDY_MULTI_CLASSES - 1)) && (requested_size >= buddy_multi_alignments[i + 1])) {
+        i++;
+    }
+    for (; i < BUDDY_MULTI_CLASSES; i++) {
+        if (multi->buddies[i] == NULL) {
+            continue;
+        }
+        result = buddy_malloc(multi->buddies[i], requested_size);
+        if (result) {
+            return result;
+        }
+    }
+    return NULL;
+}
+
+void buddy_multi_free(struct buddy_multi *multi, void *ptr) {
+    struct buddy *buddy = buddy_multi_buddy(multi, ptr);
+    if (buddy) {
+        buddy_free(buddy, ptr);
+    }
+}
+
+struct buddy *buddy_multi_buddy(struct buddy_multi *multi, void *ptr) {
+    unsigned char *addr = (unsigned char *) ptr;
+    size_t i;
+
+    if ((multi == NULL) || (ptr == NULL)) {
+        return NULL;
+    }
+    for (i = 0; i < BUDDY_MULTI_CLASSES; i++) {
+        if ((addr >= multi->start[i]) && (addr < multi->end[i])) {
+            return multi->buddies[i];
+        }
+    }
+    return NULL;
+}
+
+static struct buddy_multi_layout buddy_multi_layout(size_t small_size, size_t medium_size, size_t large_size) {
+    struct buddy_multi_layout layout;
+    size_t i, metadata, arena;
+    bool valid = false;
+
+    layout.sizes[0] = small_size;
+    layout.sizes[1] = medium_size;
+    layout.sizes[2] = large_size;
+    metadata = buddy_multi_round_up(sizeof(struct buddy_multi), sizeof(size_t));
+    arena = 0;
+    for (i = 0; i < BUDDY_MULTI_CLASSES; i++) {
+        /* Trim down arenas to their alignment */
+        layout.sizes[i] -= layout.sizes[i] % buddy_multi_alignments[i];
+        layout.metadata[i] = metadata;
+        layout.arenas[i] = buddy_multi_round_up(arena, buddy_multi_alignments[i]);
+        if (layout.sizes[i] == 0) {
+            continue;
+        }
+        metadata += buddy_multi_round_up(buddy_sizeof_alignment(layout.sizes[i], buddy_multi_alignments[i]),
+            sizeof(size_t));
+        arena = layout.arenas[i] + layout.sizes[i];
+        valid = true;
+    }
+    layout.metadata_size = valid ? metadata : 0;
+    layout.arena_size = valid ? arena : 0;
+    return layout;
+}
+
+static size_t buddy_multi_round_up(size_t value, size_t alignment) {
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+}
+#endif
+#endif
+
+#endif /* BUDDY_ALLOC_MULTI_IMPLEMENTATION */
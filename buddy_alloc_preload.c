@@ -0,0 +1,506 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ *
+ * A malloc replacement built on the binary buddy memory allocator (Linux, glibc)
+ *
+ * Interposes malloc, free, calloc, realloc, posix_memalign, aligned_alloc, memalign,
+ * valloc, pvalloc and malloc_usable_size so that unmodified programs can run on
+ * buddy_alloc. Build it as a shared library and preload it:
+ *
+ *     cc -O2 -shared -fPIC -fvisibility=hidden buddy_alloc_preload.c -o libbuddy_preload.so -lpthread -ldl
+ *     LD_PRELOAD=./libbuddy_preload.so ./application
+ *
+ * Threads are spread over sharded arenas, each guarded by its own mutex. The address
+ * range of every arena is reserved with mmap up front and memory is committed to it
+ * as it grows with buddy_resize. Small requests are served from slab pages of fixed
+ * size classes that are allocated from the arena. Requests that cannot be served and
+ * pointers that did not come from the arenas are passed on to the glibc allocator.
+ * Memory is not returned to the system when the arenas shrink in use.
+ *
+ * Latest version is available at https://github.com/spaskalev/buddy_alloc
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define BUDDY_ALLOC_IMPLEMENTATION
+#include "buddy_alloc.h"
+#undef BUDDY_ALLOC_IMPLEMENTATION
+
+/* Number of arenas that threads are spread over */
+#ifndef BUDDY_PRELOAD_SHARDS
+#define BUDDY_PRELOAD_SHARDS 8
+#endif
+
+/* Address space reserved for every arena, a power of two */
+#ifndef BUDDY_PRELOAD_SHARD_SIZE
+#define BUDDY_PRELOAD_SHARD_SIZE (1ULL << 36)
+#endif
+
+/* Memory committed to every arena on startup, a power of two */
+#ifndef BUDDY_PRELOAD_INITIAL_SIZE
+#define BUDDY_PRELOAD_INITIAL_SIZE (1ULL << 24)
+#endif
+
+#if (BUDDY_PRELOAD_SHARD_SIZE & (BUDDY_PRELOAD_SHARD_SIZE - 1)) != 0
+#error BUDDY_PRELOAD_SHARD_SIZE must be a power of two
+#endif
+#if (BUDDY_PRELOAD_INITIAL_SIZE & (BUDDY_PRELOAD_INITIAL_SIZE - 1)) != 0
+#error BUDDY_PRELOAD_INITIAL_SIZE must be a power of two
+#endif
+#if BUDDY_PRELOAD_INITIAL_SIZE > BUDDY_PRELOAD_SHARD_SIZE
+#error BUDDY_PRELOAD_INITIAL_SIZE must not exceed BUDDY_PRELOAD_SHARD_SIZE
+#endif
+
+#define BUDDY_PRELOAD_API __attribute__((visibility("default")))
+
+/* Slab pages hold objects of 16 to 256 bytes after a header */
+#define BUDDY_PRELOAD_PAGE_SIZE 4096
+#define BUDDY_PRELOAD_SLAB_CLASSES 5
+#define BUDDY_PRELOAD_SLAB_MIN 16
+#define BUDDY_PRELOAD_SLAB_MAX 256
+#define BUDDY_PRELOAD_SLAB_HEADER 64
+
+/* The alignment of malloc results */
+#define BUDDY_PRELOAD_ALIGNMENT 16
+
+/* The glibc allocator */
+extern void *__libc_malloc(size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+struct buddy_preload_slab {
+    struct buddy_preload_slab *prev; /* pages of the class that have free objects */
+    struct buddy_preload_slab *next;
+    void *free; /* released objects */
+    size_t used; /* allocated objects */
+    size_t object_size;
+    size_t unused; /* offset of the first object that was never handed out */
+};
+
+struct buddy_preload_shard {
+    pthread_mutex_t lock;
+    struct buddy *buddy;
+    unsigned char *arena;
+    size_t arena_size; /* committed */
+    unsigned char *metadata;
+    size_t metadata_size; /* committed */
+    unsigned char *slab_pages; /* a bit per arena page, set for slab pages */
+    struct buddy_preload_slab *partial[BUDDY_PRELOAD_SLAB_CLASSES];
+};
+
+static struct buddy_preload_shard buddy_preload_shards[BUDDY_PRELOAD_SHARDS];
+static unsigned char *buddy_preload_region;
+static bool buddy_preload_ready;
+static pthread_once_t buddy_preload_once = PTHREAD_ONCE_INIT;
+static unsigned int buddy_preload_next_shard;
+/* Zero until the thread is assigned a shard, the shard index plus one after that */
+static __thread unsigned int buddy_preload_thread_shard __attribute__((tls_model("initial-exec")));
+
+static void buddy_preload_init(void);
+static struct buddy_preload_shard *buddy_preload_shard_for_thread(void);
+static struct buddy_preload_shard *buddy_preload_owner(const void *ptr);
+static bool buddy_preload_commit(struct buddy_preload_shard *shard, size_t arena_size);
+static void *buddy_preload_buddy_malloc(struct buddy_preload_shard *shard, size_t size);
+static void *buddy_preload_slab_malloc(struct buddy_preload_shard *shard, size_t size);
+static struct buddy_preload_slab *buddy_preload_slab_of(struct buddy_preload_shard *shard, const void *ptr);
+static void buddy_preload_slab_free(struct buddy_preload_shard *shard, struct buddy_preload_slab *slab, void *ptr);
+static void buddy_preload_slab_unlink(struct buddy_preload_shard *shard, struct buddy_preload_slab *slab);
+static size_t buddy_preload_slab_class(size_t size);
+static void *buddy_preload_allocate(size_t size, size_t alignment);
+static size_t buddy_preload_usable_size(struct buddy_preload_shard *shard, void *ptr);
+static size_t buddy_preload_page_round(size_t size);
+static void buddy_preload_fork_prepare(void);
+static void buddy_preload_fork_release(void);
+
+BUDDY_PRELOAD_API void *malloc(size_t size) {
+    return buddy_preload_allocate(size, BUDDY_PRELOAD_ALIGNMENT);
+}
+
+BUDDY_PRELOAD_API void free(void *ptr) {
+    struct buddy_preload_shard *shard;
+    struct buddy_preload_slab *slab;
+
+    if (ptr == NULL) {
+        return;
+    }
+    shard = buddy_preload_owner(ptr);
+    if (shard == NULL) {
+        __libc_free(ptr);
+        return;
+    }
+    pthread_mutex_lock(&shard->lock);
+    slab = buddy_preload_slab_of(shard, ptr);
+    if (slab) {
+        buddy_preload_slab_free(shard, slab, ptr);
+    } else {
+        buddy_free(shard->buddy, ptr);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+BUDDY_PRELOAD_API void *calloc(size_t members_count, size_t member_size) {
+    void *result;
+    if (member_size && (members_count > (SIZE_MAX / member_size))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    /* Not through malloc, which the compiler could fold together with memset into calloc */
+    result = buddy_preload_allocate(members_count * member_size, BUDDY_PRELOAD_ALIGNMENT);
+    if (result) {
+        memset(result, 0, members_count * member_size);
+    }
+    return result;
+}
+
+BUDDY_PRELOAD_API void *realloc(void *ptr, size_t size) {
+    struct buddy_preload_shard *shard;
+    size_t usable;
+    void *result;
+
+    if (ptr == NULL) {
+        return malloc(size);
+    }
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    shard = buddy_preload_owner(ptr);
+    if (shard == NULL) {
+        return __libc_realloc(ptr, size);
+    }
+
+    /* Keep the allocation if it fits or can be resized in place */
+    pthread_mutex_lock(&shard->lock);
+    usable = buddy_preload_usable_size(shard, ptr);
+    if (buddy_preload_slab_of(shard, ptr)) {
+        if (size <= usable) {
+            pthread_mutex_unlock(&shard->lock);
+            return ptr;
+        }
+    } else if (buddy_realloc_in_place(shard->buddy, ptr, size)) {
+        pthread_mutex_unlock(&shard->lock);
+        return ptr;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    result = malloc(size);
+    if (result == NULL) {
+        return NULL;
+    }
+    memcpy(result, ptr, (usable < size) ? usable : size);
+    free(ptr);
+    return result;
+}
+
+BUDDY_PRELOAD_API int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    void *result;
+    if ((alignment < sizeof(void *)) || (alignment & (alignment - 1))) {
+        return EINVAL;
+    }
+    result = buddy_preload_allocate(size, alignment);
+    if (result == NULL) {
+        return ENOMEM;
+    }
+    *memptr = result;
+    return 0;
+}
+
+BUDDY_PRELOAD_API void *aligned_alloc(size_t alignment, size_t size) {
+    if ((alignment == 0) || (alignment & (alignment - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return buddy_preload_allocate(size, alignment);
+}
+
+BUDDY_PRELOAD_API void *memalign(size_t alignment, size_t size) {
+    return aligned_alloc(alignment, size);
+}
+
+BUDDY_PRELOAD_API void *valloc(size_t size) {
+    return buddy_preload_allocate(size, BUDDY_PRELOAD_PAGE_SIZE);
+}
+
+BUDDY_PRELOAD_API void *pvalloc(size_t size) {
+    return buddy_preload_allocate(buddy_preload_page_round(size), BUDDY_PRELOAD_PAGE_SIZE);
+}
+
+BUDDY_PRELOAD_API size_t malloc_usable_size(void *ptr) {
+    static size_t (*next_usable_size)(void *);
+    struct buddy_preload_shard *shard;
+    size_t result;
+
+    if (ptr == NULL) {
+        return 0;
+    }
+    shard = buddy_preload_owner(ptr);
+    if (shard == NULL) {
+        if (next_usable_size == NULL) {
+            *(void **) &next_usable_size = dlsym(RTLD_NEXT, "malloc_usable_size");
+        }
+        return next_usable_size ? next_usable_size(ptr) : 0;
+    }
+    pthread_mutex_lock(&shard->lock);
+    result = buddy_preload_usable_size(shard, ptr);
+    pthread_mutex_unlock(&shard->lock);
+    return result;
+}
+
+__attribute__((constructor)) static void buddy_preload_constructor(void) {
+    pthread_once(&buddy_preload_once, buddy_preload_init);
+    /* Registering can allocate, which is safe once the arenas exist */
+    pthread_atfork(buddy_preload_fork_prepare, buddy_preload_fork_release, buddy_preload_fork_release);
+}
+
+static void buddy_preload_init(void) {
+    size_t total = BUDDY_PRELOAD_SHARDS * BUDDY_PRELOAD_SHARD_SIZE;
+    size_t metadata_size = buddy_preload_page_round(
+        buddy_sizeof_alignment(BUDDY_PRELOAD_SHARD_SIZE, BUDDY_PRELOAD_SLAB_MAX));
+    size_t bits_size = buddy_preload_page_round(BUDDY_PRELOAD_SHARD_SIZE / BUDDY_PRELOAD_PAGE_SIZE / CHAR_BIT);
+    unsigned char *region, *aligned;
+
+    /* Reserve the arenas, aligned to their size so that slots are aligned to their size as well */
+    region = mmap(NULL, total + BUDDY_PRELOAD_SHARD_SIZE, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        return;
+    }
+    aligned = (unsigned char *) ((((uintptr_t) region) + BUDDY_PRELOAD_SHARD_SIZE - 1)
+        & ~((uintptr_t) BUDDY_PRELOAD_SHARD_SIZE - 1));
+    if (aligned != region) {
+        munmap(region, (size_t) (aligned - region));
+    }
+    munmap(aligned + total, BUDDY_PRELOAD_SHARD_SIZE - (size_t) (aligned - region));
+
+    for (size_t i = 0; i < BUDDY_PRELOAD_SHARDS; i++) {
+        struct buddy_preload_shard *shard = &buddy_preload_shards[i];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->arena = aligned + (i * BUDDY_PRELOAD_SHARD_SIZE);
+        shard->metadata = mmap(NULL, metadata_size, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        shard->slab_pages = mmap(NULL, bits_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if ((shard->metadata == MAP_FAILED) || (shard->slab_pages == MAP_FAILED)) {
+            return;
+        }
+        if (! buddy_preload_commit(shard, BUDDY_PRELOAD_INITIAL_SIZE)) {
+            return;
+        }
+    }
+    buddy_preload_region = aligned;
+    buddy_preload_ready = true;
+}
+
+static struct buddy_preload_shard *buddy_preload_shard_for_thread(void) {
+    pthread_once(&buddy_preload_once, buddy_preload_init);
+    if (! buddy_preload_ready) {
+        return NULL;
+    }
+    if (buddy_preload_thread_shard == 0) {
+        buddy_preload_thread_shard = 1 +
+            (__atomic_fetch_add(&buddy_preload_next_shard, 1u, __ATOMIC_RELAXED) % BUDDY_PRELOAD_SHARDS);
+    }
+    return &buddy_preload_shards[buddy_preload_thread_shard - 1];
+}
+
+static struct buddy_preload_shard *buddy_preload_owner(const void *ptr) {
+    uintptr_t address = (uintptr_t) ptr;
+    uintptr_t start = (uintptr_t) buddy_preload_region;
+
+    if ((! buddy_preload_ready) || (address < start)
+            || (address >= (start + (BUDDY_PRELOAD_SHARDS * BUDDY_PRELOAD_SHARD_SIZE)))) {
+        return NULL;
+    }
+    return &buddy_preload_shards[(address - start) / BUDDY_PRELOAD_SHARD_SIZE];
+}
+
+static bool buddy_preload_commit(struct buddy_preload_shard *shard, size_t arena_size) {
+    size_t metadata_size = buddy_preload_page_round(buddy_sizeof_alignment(arena_size, BUDDY_PRELOAD_SLAB_MAX));
+
+    if (mprotect(shard->arena, arena_size, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
+    if ((metadata_size > shard->metadata_size)
+            && (mprotect(shard->metadata, metadata_size, PROT_READ | PROT_WRITE) != 0)) {
+        return false;
+    }
+    shard->metadata_size = (metadata_size > shard->metadata_size) ? metadata_size : shard->metadata_size;
+    if (shard->buddy == NULL) {
+        /* The arena serves slab pages and requests larger than the slab objects */
+        shard->buddy = buddy_init_alignment(shard->metadata, shard->arena, arena_size, BUDDY_PRELOAD_SLAB_MAX);
+    } else if (buddy_resize(shard->buddy, arena_size) == NULL) {
+        return false;
+    }
+    shard->arena_size = arena_size;
+    return shard->buddy != NULL;
+}
+
+static void *buddy_preload_buddy_malloc(struct buddy_preload_shard *shard, size_t size) {
+    void *result = buddy_malloc(shard->buddy, size);
+
+    /* Grow the arena until the request fits or the reservation is exhausted */
+    while ((result == NULL) && (shard->arena_size < BUDDY_PRELOAD_SHARD_SIZE)) {
+        if (! buddy_preload_commit(shard, shard->arena_size * 2)) {
+            return NULL;
+        }
+        result = buddy_malloc(shard->buddy, size);
+    }
+    return result;
+}
+
+static void *buddy_preload_slab_malloc(struct buddy_preload_shard *shard, size_t size) {
+    size_t class = buddy_preload_slab_class(size);
+    struct buddy_preload_slab *slab = shard->partial[class];
+    size_t page;
+    void *result;
+
+    if (slab == NULL) {
+        slab = buddy_preload_buddy_malloc(shard, BUDDY_PRELOAD_PAGE_SIZE);
+        if (slab == NULL) {
+            return NULL;
+        }
+        slab->prev = NULL;
+        slab->next = NULL;
+        slab->free = NULL;
+        slab->used = 0;
+        slab->object_size = (size_t) BUDDY_PRELOAD_SLAB_MIN << class;
+        slab->unused = BUDDY_PRELOAD_SLAB_HEADER;
+        shard->partial[class] = slab;
+        page = (size_t) ((unsigned char *) slab - shard->arena) / BUDDY_PRELOAD_PAGE_SIZE;
+        bitset_set(shard->slab_pages, page);
+    }
+
+    if (slab->free) {
+        result = slab->free;
+        memcpy(&slab->free, result, sizeof(slab->free));
+    } else {
+        result = (unsigned char *) slab + slab->unused;
+        slab->unused += slab->object_size;
+    }
+    slab->used++;
+
+    /* A full page leaves the list */
+    if ((slab->free == NULL) && ((slab->unused + slab->object_size) > BUDDY_PRELOAD_PAGE_SIZE)) {
+        buddy_preload_slab_unlink(shard, slab);
+    }
+    return result;
+}
+
+static struct buddy_preload_slab *buddy_preload_slab_of(struct buddy_preload_shard *shard, const void *ptr) {
+    size_t offset = (size_t) ((const unsigned char *) ptr - shard->arena);
+    if (! bitset_test(shard->slab_pages, offset / BUDDY_PRELOAD_PAGE_SIZE)) {
+        return NULL;
+    }
+    return (struct buddy_preload_slab *) (shard->arena + (offset & ~((size_t) BUDDY_PRELOAD_PAGE_SIZE - 1)));
+}
+
+static void buddy_preload_slab_free(struct buddy_preload_shard *shard, struct buddy_preload_slab *slab, void *ptr) {
+    size_t class = buddy_preload_slab_class(slab->object_size);
+    size_t offset = (size_t) ((unsigned char *) ptr - (unsigned char *) slab);
+    bool full = (slab->free == NULL) && ((slab->unused + slab->object_size) > BUDDY_PRELOAD_PAGE_SIZE);
+    size_t page;
+
+    /* Ignore addresses that are not objects that were handed out */
+    if ((offset < BUDDY_PRELOAD_SLAB_HEADER) || (offset >= slab->unused)
+            || ((offset - BUDDY_PRELOAD_SLAB_HEADER) % slab->object_size)) {
+        return;
+    }
+    memcpy(ptr, &slab->free, sizeof(slab->free));
+    slab->free = ptr;
+    slab->used--;
+
+    if (full) {
+        /* Back on the list */
+        slab->prev = NULL;
+        slab->next = shard->partial[class];
+        if (slab->next) {
+            slab->next->prev = slab;
+        }
+        shard->partial[class] = slab;
+    } else if ((slab->used == 0) && (slab->prev || slab->next)) {
+        /* Return an empty page unless it is the last one of its class */
+        buddy_preload_slab_unlink(shard, slab);
+        page = (size_t) ((unsigned char *) slab - shard->arena) / BUDDY_PRELOAD_PAGE_SIZE;
+        bitset_clear(shard->slab_pages, page);
+        buddy_free(shard->buddy, slab);
+    }
+}
+
+static void buddy_preload_slab_unlink(struct buddy_preload_shard *shard, struct buddy_preload_slab *slab) {
+    size_t class = buddy_preload_slab_class(slab->object_size);
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        shard->partial[class] = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+static size_t buddy_preload_slab_class(size_t size) {
+    size_t class = 0;
+    while (((size_t) BUDDY_PRELOAD_SLAB_MIN << class) < size) {
+        class++;
+    }
+    return class;
+}
+
+static void *buddy_preload_allocate(size_t size, size_t alignment) {
+    struct buddy_preload_shard *shard = buddy_preload_shard_for_thread();
+    size_t requested = (size < alignment) ? alignment : size;
+    void *result = NULL;
+
+    if (requested == 0) {
+        requested = 1;
+    }
+    if (shard && (alignment <= BUDDY_PRELOAD_SHARD_SIZE) && (requested <= BUDDY_PRELOAD_SHARD_SIZE)) {
+        pthread_mutex_lock(&shard->lock);
+        if ((requested <= BUDDY_PRELOAD_SLAB_MAX) && (alignment <= BUDDY_PRELOAD_ALIGNMENT)) {
+            result = buddy_preload_slab_malloc(shard, requested);
+        } else {
+            result = buddy_preload_buddy_malloc(shard, requested);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    if (result == NULL) {
+        result = (alignment <= BUDDY_PRELOAD_ALIGNMENT) ? __libc_malloc(size) : __libc_memalign(alignment, size);
+    }
+    return result;
+}
+
+static size_t buddy_preload_usable_size(struct buddy_preload_shard *shard, void *ptr) {
+    struct buddy_preload_slab *slab = buddy_preload_slab_of(shard, ptr);
+    if (slab) {
+        return slab->object_size;
+    }
+    return buddy_usable_size(shard->buddy, ptr);
+}
+
+static size_t buddy_preload_page_round(size_t size) {
+    return (size + BUDDY_PRELOAD_PAGE_SIZE - 1) & ~((size_t) BUDDY_PRELOAD_PAGE_SIZE - 1);
+}
+
+static void buddy_preload_fork_prepare(void) {
+    for (size_t i = 0; i < BUDDY_PRELOAD_SHARDS; i++) {
+        pthread_mutex_lock(&buddy_preload_shards[i].lock);
+    }
+}
+
+static void buddy_preload_fork_release(void) {
+    for (size_t i = BUDDY_PRELOAD_SHARDS; i; i--) {
+        pthread_mutex_unlock(&buddy_preload_shards[i - 1].lock);
+    }
+}
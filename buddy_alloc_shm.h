@@ -0,0 +1,290 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ *
+ * A process-shared binary buddy memory allocator (POSIX)
+ *
+ * Places an embedded buddy allocator in a shared memory region and guards
+ * it with a robust process-shared mutex. Allocations are referred to by
+ * offset handles that are valid in every process that maps the region.
+ *
+ * To include and use it in your project do the following
+ * 1. Add buddy_alloc.h and buddy_alloc_shm.h (this file) to your include directory
+ * 2. Include the header in places where you need to use the allocator
+ * 3. In one of your source files #define BUDDY_ALLOC_IMPLEMENTATION
+ *    and BUDDY_ALLOC_SHM_IMPLEMENTATION and then import the header.
+ *    This will insert the implementation.
+ * 4. Link with -lpthread (and -lrt for shm_open on older systems)
+ *
+ * Latest version is available at https://github.com/spaskalev/buddy_alloc
+ */
+
+#ifndef BUDDY_ALLOC_SHM_H
+#define BUDDY_ALLOC_SHM_H
+
+#ifndef BUDDY_HEADER
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "buddy_alloc.h"
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+extern "C" {
+#endif
+#endif
+
+struct buddy_shm;
+
+/*
+ * Initializes a process-shared allocator in the shared memory object referred to by fd.
+ *
+ * The descriptor can come from shm_open or memfd_create. It is resized to the
+ * requested size and mapped. The region holds a small header, followed by an
+ * embedded allocator that manages the rest of it.
+ *
+ * Returns NULL on failure.
+ */
+struct buddy_shm *buddy_shm_create(int fd, size_t size);
+
+/*
+ * Maps a process-shared allocator that was created by buddy_shm_create.
+ * The region can be mapped at a different address in every process.
+ *
+ * Returns NULL on failure.
+ */
+struct buddy_shm *buddy_shm_attach(int fd);
+
+/* Unmaps the region from the calling process. The shared state is preserved. */
+void buddy_shm_detach(struct buddy_shm *shm);
+
+/*
+ * Allocates memory and returns its handle or zero on failure.
+ * Handles are the same in every process, use buddy_shm_pointer to access the memory.
+ */
+size_t buddy_shm_malloc(struct buddy_shm *shm, size_t requested_size);
+
+/* Frees the memory referred to by a handle. A zero handle is ignored. */
+void buddy_shm_free(struct buddy_shm *shm, size_t handle);
+
+/* Returns the address of a handle in the calling process or NULL for a zero handle. */
+void *buddy_shm_pointer(struct buddy_shm *shm, size_t handle);
+
+/* Returns the handle of an address in the calling process or zero if it is outside of the region. */
+size_t buddy_shm_handle(struct buddy_shm *shm, void *ptr);
+
+/*
+ * Locks the shared allocator and returns it for use with the buddy_* functions.
+ * Addresses returned by them are local to the calling process.
+ *
+ * If the previous owner died while holding the lock the allocator is rebuilt
+ * with buddy_recover first, as the owner may have died in the middle of an
+ * operation. A free that was interrupted may leave its memory allocated.
+ *
+ * Returns NULL if the lock cannot be acquired.
+ */
+struct buddy *buddy_shm_lock(struct buddy_shm *shm);
+
+/* Unlocks the shared allocator */
+void buddy_shm_unlock(struct buddy_shm *shm);
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+}
+#endif
+#endif
+
+#endif /* BUDDY_ALLOC_SHM_H */
+
+#ifdef BUDDY_ALLOC_SHM_IMPLEMENTATION
+#undef BUDDY_ALLOC_SHM_IMPLEMENTATION
+
+#ifndef BUDDY_HEADER
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+extern "C" {
+#endif
+#endif
+
+/* Identifies an initialized region, spells "buddyshm" */
+#define BUDDY_SHM_MAGIC 0x627564647973686dULL
+
+struct buddy_shm {
+    uint64_t magic;
+    size_t size;
+    pthread_mutex_t lock;
+};
+
+static size_t buddy_shm_header_size(void);
+static unsigned char *buddy_shm_arena(struct buddy_shm *shm);
+static struct buddy *buddy_shm_buddy(struct buddy_shm *shm);
+
+struct buddy_shm *buddy_shm_create(int fd, size_t size) {
+    pthread_mutexattr_t attr;
+    struct buddy_shm *shm;
+    void *region;
+
+    if (size <= buddy_shm_header_size()) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t) size) != 0) {
+        return NULL;
+    }
+    region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    shm = (struct buddy_shm *) region;
+    shm->size = size;
+
+    if (! buddy_embed(buddy_shm_arena(shm), size - buddy_shm_header_size())) {
+        munmap(region, size);
+        return NULL;
+    }
+
+    /* The lock must survive the death of its owner and be usable from any process */
+    if (pthread_mutexattr_init(&attr) != 0) {
+        munmap(region, size);
+        return NULL;
+    }
+    if ((pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0)
+            || (pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) != 0)
+            || (pthread_mutex_init(&shm->lock, &attr) != 0)) {
+        pthread_mutexattr_destroy(&attr);
+        munmap(region, size);
+        return NULL;
+    }
+    pthread_mutexattr_destroy(&attr);
+
+    /* Publish the region last, attaching before this point fails */
+    shm->magic = BUDDY_SHM_MAGIC;
+    return shm;
+}
+
+struct buddy_shm *buddy_shm_attach(int fd) {
+    struct stat st;
+    struct buddy_shm *shm;
+    void *region;
+
+    if (fstat(fd, &st) != 0) {
+        return NULL;
+    }
+    if ((size_t) st.st_size <= buddy_shm_header_size()) {
+        return NULL;
+    }
+    region = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    shm = (struct buddy_shm *) region;
+    if ((shm->magic != BUDDY_SHM_MAGIC) || (shm->size != (size_t) st.st_size)) {
+        munmap(region, (size_t) st.st_size);
+        return NULL;
+    }
+    return shm;
+}
+
+void buddy_shm_detach(struct buddy_shm *shm) {
+    if (shm == NULL) {
+        return;
+    }
+    munmap(shm, shm->size);
+}
+
+size_t buddy_shm_malloc(struct buddy_shm *shm, size_t requested_size) {
+    struct buddy *buddy;
+    void *result;
+
+    buddy = buddy_shm_lock(shm);
+    if (buddy == NULL) {
+        return 0;
+    }
+    result = buddy_malloc(buddy, requested_size);
+    buddy_shm_unlock(shm);
+    return buddy_shm_handle(shm, result);
+}
+
+void buddy_shm_free(struct buddy_shm *shm, size_t handle) {
+    struct buddy *buddy;
+
+    if (handle == 0) {
+        return;
+    }
+    buddy = buddy_shm_lock(shm);
+    if (buddy == NULL) {
+        return;
+    }
+    buddy_free(buddy, buddy_shm_pointer(shm, handle));
+    buddy_shm_unlock(shm);
+}
+
+void *buddy_shm_pointer(struct buddy_shm *shm, size_t handle) {
+    if ((handle == 0) || (handle >= shm->size)) {
+        return NULL;
+    }
+    return (unsigned char *) shm + handle;
+}
+
+size_t buddy_shm_handle(struct buddy_shm *shm, void *ptr) {
+    unsigned char *addr = (unsigned char *) ptr;
+
+    if ((addr < buddy_shm_arena(shm)) || (addr >= ((unsigned char *) shm + shm->size))) {
+        return 0;
+    }
+    return (size_t) (addr - (unsigned char *) shm);
+}
+
+struct buddy *buddy_shm_lock(struct buddy_shm *shm) {
+    if (shm == NULL) {
+        return NULL;
+    }
+    switch (pthread_mutex_lock(&shm->lock)) {
+    case 0:
+        break;
+    case EOWNERDEAD:
+        /* The previous owner died while holding the lock, possibly mid-operation */
+        if (pthread_mutex_consistent(&shm->lock) != 0) {
+            pthread_mutex_unlock(&shm->lock);
+            return NULL;
+        }
+        buddy_recover(buddy_shm_buddy(shm));
+        break;
+    default:
+        return NULL;
+    }
+    return buddy_shm_buddy(shm);
+}
+
+void buddy_shm_unlock(struct buddy_shm *shm) {
+    pthread_mutex_unlock(&shm->lock);
+}
+
+static size_t buddy_shm_header_size(void) {
+    /* Keep the arena aligned to the default allocator alignment */
+    size_t align = sizeof(size_t) * CHAR_BIT;
+    return ((sizeof(struct buddy_shm) + align - 1) / align) * align;
+}
+
+static unsigned char *buddy_shm_arena(struct buddy_shm *shm) {
+    return (unsigned char *) shm + buddy_shm_header_size();
+}
+
+static struct buddy *buddy_shm_buddy(struct buddy_shm *shm) {
+    /* The embedded allocator is relocatable, find it at this process' mapping */
+    return buddy_get_embed_at(buddy_shm_arena(shm), shm->size - buddy_shm_header_size());
+}
+
+#ifdef __cplusplus
+#ifndef BUDDY_CPP_MANGLED
+}
+#endif
+#endif
+
+#endif /* BUDDY_ALLOC_SHM_IMPLEMENTATION */
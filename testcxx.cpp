@@ -2,14 +2,621 @@
  * Copyright 2020-2021 Stanislav Paskalev <spaskalev@protonmail.com>
  */
 
+#define START_TEST printf("Running test: %s in %s:%d\n", __func__, __FILE__, __LINE__);
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <utility>
+#include <vector>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
 // Just include buddy_alloc from C++
 #define BUDDY_ALLOC_IMPLEMENTATION
 #include "buddy_alloc.h"
 #undef BUDDY_ALLOC_IMPLEMENTATION
 
+#include "buddy_alloc.hpp"
+
+void test_allocator() {
+    unsigned char *buddy_buf = static_cast<unsigned char *>(std::malloc(buddy_sizeof(65536)));
+    unsigned char *data_buf = static_cast<unsigned char *>(std::malloc(65536));
+    struct buddy *allocator;
+    START_TEST;
+    allocator = buddy_init(buddy_buf, data_buf, 65536);
+    {
+        buddy_alloc::allocator<int> ints(allocator);
+        buddy_alloc::allocator<long> longs(ints);
+        std::vector<int, buddy_alloc::allocator<int> > values(ints);
+        std::list<int, buddy_alloc::allocator<int> > nodes(ints);
+        assert(longs.get() == allocator);
+        assert(ints == longs);
+        assert(! (ints != longs));
+
+        for (int i = 0; i < 200; i++) {
+            values.push_back(i);
+            nodes.push_back(i);
+        }
+        assert(reinterpret_cast<unsigned char *>(values.data()) >= data_buf);
+        assert(reinterpret_cast<unsigned char *>(values.data()) < data_buf + 65536);
+
+        /* A slot is a power of two */
+        int *ptr = ints.allocate(100);
+        assert(buddy_usable_size(allocator, ptr) == 512);
+        ints.deallocate(ptr, 100);
+
+#if defined(__cpp_lib_allocate_at_least)
+        std::allocation_result<int *, std::size_t> result = ints.allocate_at_least(100);
+        assert(result.count == 128);
+        ints.deallocate(result.ptr, result.count);
+#endif
+
+        bool thrown = false;
+        try {
+            (void) ints.allocate(ints.max_size() + 1);
+        } catch (const std::bad_alloc &) {
+            thrown = true;
+        }
+        assert(thrown);
+        thrown = false;
+        try {
+            (void) ints.allocate(65536);
+        } catch (const std::bad_alloc &) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    assert(buddy_is_empty(allocator));
+    std::free(data_buf);
+    std::free(buddy_buf);
+}
+
+void test_allocator_propagation() {
+    unsigned char *first_buf = static_cast<unsigned char *>(std::malloc(buddy_sizeof(4096)));
+    unsigned char *second_buf = static_cast<unsigned char *>(std::malloc(buddy_sizeof(4096)));
+    unsigned char *first_data = static_cast<unsigned char *>(std::malloc(4096));
+    unsigned char *second_data = static_cast<unsigned char *>(std::malloc(4096));
+    struct buddy *first, *second;
+    START_TEST;
+    first = buddy_init(first_buf, first_data, 4096);
+    second = buddy_init(second_buf, second_data, 4096);
+    {
+        typedef std::vector<int, buddy_alloc::allocator<int> > vector;
+        vector a(10, 1, buddy_alloc::allocator<int>(first));
+        vector b(20, 2, buddy_alloc::allocator<int>(second));
+        assert(a.get_allocator() != b.get_allocator());
+
+        /* The allocator follows the elements */
+        std::swap(a, b);
+        assert(a.get_allocator().get() == second);
+        assert(reinterpret_cast<unsigned char *>(a.data()) >= second_data);
+        a = b;
+        assert(a.get_allocator().get() == first);
+        vector c(b.get_allocator());
+        c = std::move(a);
+        assert(c.get_allocator().get() == first);
+        vector d(c);
+        assert(d.get_allocator().get() == first);
+    }
+    assert(buddy_is_empty(first));
+    assert(buddy_is_empty(second));
+
+    /* An arena that is less aligned than the type */
+    struct alignas(128) aligned {
+        char value;
+    };
+    first = buddy_init(first_buf, first_data + 192 - (reinterpret_cast<std::uintptr_t>(first_data) % 128), 2048);
+    {
+        buddy_alloc::allocator<aligned> alloc(first);
+        bool thrown = false;
+        try {
+            (void) alloc.allocate(1);
+        } catch (const std::bad_alloc &) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(buddy_is_empty(first));
+    }
+    std::free(second_data);
+    std::free(first_data);
+    std::free(second_buf);
+    std::free(first_buf);
+}
+
+/* Points to itself and counts the live objects, moves can throw when asked to */
+struct tracked {
+    static int live;
+    static bool throwing;
+    tracked *self;
+    int value;
+
+    explicit tracked(int v) : self(this), value(v) {
+        live++;
+    }
+    tracked(const tracked &other) : self(this), value(other.value) {
+        if (throwing && (value == 2)) {
+            throw std::bad_alloc();
+        }
+        live++;
+    }
+    ~tracked() {
+        assert(self == this);
+        live--;
+    }
+};
+
+int tracked::live = 0;
+bool tracked::throwing = false;
+
+/* Moved by copying its bytes */
+struct relocated {
+    int value;
+    relocated(int v) : value(v) {}
+    relocated(const relocated &) {
+        assert(false);
+    }
+};
+
+template <>
+struct buddy_alloc::is_trivially_relocatable<relocated> : std::true_type {};
+
+void test_realloc_typed() {
+    unsigned char *buddy_buf = static_cast<unsigned char *>(std::malloc(buddy_sizeof(4096)));
+    alignas(128) static unsigned char data_buf[4096];
+    struct buddy *allocator;
+    START_TEST;
+    allocator = buddy_init(buddy_buf, data_buf, 4096);
+
+    /* Growth in place */
+    int *ints = buddy_alloc::realloc_typed<int>(allocator, nullptr, 0, 16);
+    assert(ints == reinterpret_cast<int *>(data_buf));
+    for (int i = 0; i < 16; i++) {
+        ints[i] = i;
+    }
+    assert(buddy_alloc::realloc_typed(allocator, ints, 16, 32) == ints);
+    assert(buddy_usable_size(allocator, ints) == 128);
+
+    /* Growth by relocation */
+    void *blocker = buddy_malloc(allocator, 128);
+    int *moved = buddy_alloc::realloc_typed(allocator, ints, 32, 64);
+    assert(moved != ints);
+    for (int i = 0; i < 16; i++) {
+        assert(moved[i] == i);
+    }
+    assert(buddy_alloc::realloc_typed(allocator, moved, 64, 0) == nullptr);
+    buddy_free(allocator, blocker);
+    assert(buddy_is_empty(allocator));
+
+    /* Failures */
+    assert(buddy_alloc::realloc_typed<int>(allocator, nullptr, 0, 0) == nullptr);
+    assert(buddy_alloc::realloc_typed<int>(allocator, nullptr, 0, std::numeric_limits<std::size_t>::max()) == nullptr);
+    ints = buddy_alloc::realloc_typed<int>(allocator, nullptr, 0, 16);
+    assert(buddy_alloc::realloc_typed(allocator, ints, 16, 2048) == nullptr);
+    assert(buddy_usable_size(allocator, ints) == 64);
+    buddy_free(allocator, ints);
+
+    /* Objects are moved with their constructors */
+    tracked *objects = buddy_alloc::realloc_typed<tracked>(allocator, nullptr, 0, 4);
+    for (int i = 0; i < 4; i++) {
+        ::new (static_cast<void *>(objects + i)) tracked(i);
+    }
+    blocker = buddy_malloc(allocator, 64);
+    objects = buddy_alloc::realloc_typed(allocator, objects, 4, 8);
+    assert(tracked::live == 4);
+    for (int i = 0; i < 4; i++) {
+        assert(objects[i].self == &objects[i]);
+        assert(objects[i].value == i);
+        ::new (static_cast<void *>(objects + 4 + i)) tracked(4 + i);
+    }
+    /* .. and destroyed when shrinking */
+    objects = buddy_alloc::realloc_typed(allocator, objects, 8, 3);
+    assert(tracked::live == 3);
+
+    /* A throwing constructor leaves the objects in place */
+    tracked::throwing = true;
+    bool thrown = false;
+    try {
+        buddy_alloc::realloc_typed(allocator, objects, 3, 64);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown);
+    tracked::throwing = false;
+    assert(tracked::live == 3);
+    assert(objects[2].value == 2);
+    assert(buddy_alloc::realloc_typed(allocator, objects, 3, 0) == nullptr);
+    assert(tracked::live == 0);
+
+    /* Trivially relocatable objects are moved by copying their bytes */
+    relocated *values = buddy_alloc::realloc_typed<relocated>(allocator, nullptr, 0, 1);
+    ::new (static_cast<void *>(values)) relocated(7);
+    values = buddy_alloc::realloc_typed(allocator, values, 1, 64);
+    assert(values->value == 7);
+    assert(buddy_safe_free(allocator, values, 64 * sizeof(relocated)) == BUDDY_SAFE_FREE_SUCCESS);
+    buddy_free(allocator, blocker);
+    assert(buddy_is_empty(allocator));
+
+    /* An arena that is less aligned than the type */
+    struct alignas(128) aligned {
+        char value;
+    };
+    allocator = buddy_init(buddy_buf, data_buf + 64, 2048);
+    assert(buddy_alloc::realloc_typed<aligned>(allocator, nullptr, 0, 1) == nullptr);
+    assert(buddy_is_empty(allocator));
+    std::free(buddy_buf);
+}
+
+void test_arena() {
+    static buddy_alloc::arena<7, 64> arena;
+    START_TEST;
+    static_assert(buddy_alloc::arena<7, 64>::size == 4096, "arena size");
+    assert((buddy_alloc::arena<7, 64>::metadata_size == buddy_sizeof_alignment(4096, 64)));
+    assert(arena.get() != NULL);
+    assert(reinterpret_cast<std::uintptr_t>(arena.data()) % 64 == 0);
+
+    void *ptr = arena.allocate(100);
+    assert(ptr == arena.data());
+    {
+        std::vector<int, buddy_alloc::allocator<int> > values(buddy_alloc::allocator<int>(arena.get()));
+        values.resize(100);
+        assert(reinterpret_cast<unsigned char *>(values.data()) >= arena.data());
+        assert(reinterpret_cast<unsigned char *>(values.data()) < arena.data() + arena.size);
+    }
+    arena.deallocate(ptr, 100);
+    assert(buddy_is_empty(arena.get()));
+}
+
+void test_unique_arena() {
+    START_TEST;
+    buddy_alloc::unique_arena standard(65536);
+    buddy_alloc::unique_arena embedded(65536, buddy_alloc::unique_arena::mode::embedded);
+    buddy_alloc::unique_arena aligned(65536, 128);
+    buddy_alloc::unique_arena aligned_embedded(65536, 128, buddy_alloc::unique_arena::mode::embedded);
+    assert(buddy_arena_size(standard.get()) == 65536);
+    assert(buddy_arena_size(embedded.get()) < 65536);
+    assert(buddy_main(embedded.get()) == embedded.data());
+    assert(buddy_malloc(aligned.get(), 1) == aligned.data());
+    assert(buddy_malloc(aligned.get(), 1) == aligned.data() + 128);
+    assert(buddy_main(aligned_embedded.get()) == aligned_embedded.data());
+
+    /* The storage is aligned to the allocator alignment */
+    assert(reinterpret_cast<std::uintptr_t>(standard.data()) % BUDDY_ALLOC_ALIGN == 0);
+    assert(reinterpret_cast<std::uintptr_t>(embedded.data()) % BUDDY_ALLOC_ALIGN == 0);
+    assert(reinterpret_cast<std::uintptr_t>(aligned.data()) % 128 == 0);
+    assert(reinterpret_cast<std::uintptr_t>(aligned_embedded.data()) % 128 == 0);
+    {
+        struct alignas(64) line {
+            char value;
+        };
+        buddy_alloc::unique_arena lines(4096, 64);
+        buddy_alloc::unique_ptr<line> first = buddy_alloc::make_unique<line>(lines.get());
+        buddy_alloc::unique_ptr<line> second = buddy_alloc::make_unique<line>(lines.get());
+        assert(reinterpret_cast<std::uintptr_t>(first.get()) % 64 == 0);
+        assert(reinterpret_cast<std::uintptr_t>(second.get()) % 64 == 0);
+    }
+
+    /* Moving the handle does not move the allocator */
+    struct buddy *allocator = standard.get();
+    buddy_alloc::unique_arena moved(std::move(standard));
+    assert(moved.get() == allocator);
+    assert(standard.get() == nullptr);
+    standard = std::move(moved);
+    assert(standard.get() == allocator);
+
+    bool thrown = false;
+    try {
+        buddy_alloc::unique_arena invalid(0);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        buddy_alloc::unique_arena invalid(4, buddy_alloc::unique_arena::mode::embedded);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        buddy_alloc::unique_arena invalid(4096, 3);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        buddy_alloc::unique_arena invalid(4096, 96);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+/* Throws on construction when asked to */
+struct fragile {
+    static bool throwing;
+    int value;
+    fragile() : value(1) {
+        if (throwing) {
+            throw std::bad_alloc();
+        }
+    }
+    explicit fragile(int v) : value(v) {
+        if (throwing) {
+            throw std::bad_alloc();
+        }
+    }
+};
+
+bool fragile::throwing = false;
+
+void test_make_unique() {
+    START_TEST;
+    buddy_alloc::unique_arena arena(4096);
+    struct buddy *allocator = arena.get();
+    static_assert(sizeof(buddy_alloc::unique_ptr<int>) == 2 * sizeof(void *), "a pointer and an allocator");
+    {
+        buddy_alloc::unique_ptr<tracked> object = buddy_alloc::make_unique<tracked>(allocator, 5);
+        assert(object->value == 5);
+        assert(tracked::live == 1);
+        assert(object.get_deleter().get() == allocator);
+        assert(buddy_usable_size(allocator, object.get()) == 64);
+
+        buddy_alloc::unique_ptr<int[]> values = buddy_alloc::make_unique<int[]>(allocator, 100);
+        for (int i = 0; i < 100; i++) {
+            assert(values[i] == 0);
+        }
+        assert(values.get_deleter().size() == 100);
+        assert(buddy_usable_size(allocator, values.get()) == 512);
+
+        buddy_alloc::unique_ptr<fragile[]> objects = buddy_alloc::make_unique<fragile[]>(allocator, 0);
+        buddy_alloc::unique_ptr<int> value = buddy_alloc::make_unique<int>(allocator);
+        assert(*value == 0);
+        buddy_alloc::unique_ptr<fragile> overwrite = buddy_alloc::make_unique_for_overwrite<fragile>(allocator);
+        assert(overwrite->value == 1);
+        buddy_alloc::unique_ptr<char[]> bytes = buddy_alloc::make_unique_for_overwrite<char[]>(allocator, 1000);
+        assert(buddy_usable_size(allocator, bytes.get()) == 1024);
+    }
+    assert(tracked::live == 0);
+    assert(buddy_is_empty(allocator));
+
+    /* Memory is returned when a constructor throws */
+    fragile::throwing = true;
+    int thrown = 0;
+    try {
+        buddy_alloc::make_unique<fragile>(allocator, 2);
+    } catch (const std::bad_alloc &) {
+        thrown++;
+    }
+    try {
+        buddy_alloc::make_unique_for_overwrite<fragile>(allocator);
+    } catch (const std::bad_alloc &) {
+        thrown++;
+    }
+    try {
+        buddy_alloc::make_unique<fragile[]>(allocator, 4);
+    } catch (const std::bad_alloc &) {
+        thrown++;
+    }
+    fragile::throwing = false;
+    assert(thrown == 3);
+    assert(buddy_is_empty(allocator));
+
+    /* .. and when the allocator is exhausted */
+    thrown = 0;
+    try {
+        buddy_alloc::make_unique<int[]>(allocator, 2048);
+    } catch (const std::bad_alloc &) {
+        thrown++;
+    }
+    try {
+        buddy_alloc::make_unique_for_overwrite<int[]>(allocator, std::numeric_limits<std::size_t>::max());
+    } catch (const std::bad_alloc &) {
+        thrown++;
+    }
+    assert(thrown == 2);
+    assert(buddy_is_empty(allocator));
+
+    /* An arena that is less aligned than the type */
+    struct alignas(128) aligned {
+        char value;
+    };
+    alignas(128) static unsigned char data_buf[4096];
+    unsigned char *buddy_buf = static_cast<unsigned char *>(std::malloc(buddy_sizeof(2048)));
+    allocator = buddy_init(buddy_buf, data_buf + 64, 2048);
+    thrown = 0;
+    try {
+        buddy_alloc::make_unique<aligned>(allocator);
+    } catch (const std::bad_alloc &) {
+        thrown++;
+    }
+    assert(thrown == 1);
+    assert(buddy_is_empty(allocator));
+    std::free(buddy_buf);
+}
+
+#if defined(__cpp_lib_memory_resource)
+void test_memory_resource() {
+    alignas(4096) static unsigned char data_buf[65536];
+    unsigned char *buddy_buf = static_cast<unsigned char *>(std::malloc(buddy_sizeof(65536)));
+    struct buddy *allocator;
+    START_TEST;
+    allocator = buddy_init(buddy_buf, data_buf, 65536);
+    {
+        buddy_alloc::memory_resource resource(allocator);
+        buddy_alloc::memory_resource same(allocator);
+        std::pmr::vector<int> values(&resource);
+        assert(resource.get() == allocator);
+        assert(resource.is_equal(same));
+        assert(! resource.is_equal(*std::pmr::new_delete_resource()));
+
+        for (int i = 0; i < 1000; i++) {
+            values.push_back(i);
+        }
+        assert(! buddy_is_empty(allocator));
+        assert(reinterpret_cast<unsigned char *>(values.data()) >= data_buf);
+        assert(reinterpret_cast<unsigned char *>(values.data()) < data_buf + 65536);
+
+        /* Over-aligned requests */
+        void *ptr = resource.allocate(10, 1024);
+        assert(reinterpret_cast<std::uintptr_t>(ptr) % 1024 == 0);
+        resource.deallocate(ptr, 10, 1024);
+
+        /* Exhaustion is reported with an exception */
+        bool thrown = false;
+        try {
+            (void) resource.allocate(65536);
+        } catch (const std::bad_alloc &) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    assert(buddy_is_empty(allocator));
+
+    /* An arena that is less aligned than the request */
+    allocator = buddy_init(buddy_buf, data_buf + 64, 4096);
+    {
+        buddy_alloc::memory_resource resource(allocator);
+        bool thrown = false;
+        try {
+            (void) resource.allocate(64, 4096);
+        } catch (const std::bad_alloc &) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(buddy_is_empty(allocator));
+    }
+    std::free(buddy_buf);
+}
+#else
+#define test_memory_resource()
+#endif
+
+#if defined(__cpp_impl_coroutine)
+/* A coroutine that suspends once and is destroyed by its owner */
+struct task {
+    struct promise_type : buddy_alloc::promise_base {
+        int value = 0;
+        task get_return_object() {
+            return task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(int result) { value = result; }
+        void unhandled_exception() { throw; }
+    };
+
+    explicit task(std::coroutine_handle<promise_type> coroutine) : handle(coroutine) {}
+    task(task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    ~task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    int get() {
+        handle.resume();
+        return handle.promise().value;
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+task add(int a, int b) {
+    co_return a + b;
+}
+
+void test_coroutine_allocator() {
+    alignas(4096) static unsigned char data_buf[4096];
+    alignas(4096) static unsigned char other_data[4096];
+    unsigned char *buddy_buf = static_cast<unsigned char *>(std::malloc(buddy_sizeof(4096)));
+    unsigned char *other_buf = static_cast<unsigned char *>(std::malloc(buddy_sizeof(4096)));
+    struct buddy *allocator, *other;
+    START_TEST;
+    allocator = buddy_init(buddy_buf, data_buf, 4096);
+    other = buddy_init(other_buf, other_data, 4096);
+    assert(buddy_alloc::coroutine_allocator::get() == nullptr);
+    {
+        /* Without a binding the frame comes from the heap */
+        task unbound = add(1, 2);
+        assert(unbound.get() == 3);
+    }
+    {
+        buddy_alloc::coroutine_allocator scope(allocator);
+        assert(buddy_alloc::coroutine_allocator::get() == allocator);
+        task first = add(2, 3);
+        assert(! buddy_is_empty(allocator));
+        {
+            buddy_alloc::coroutine_allocator nested(other);
+            task second = add(3, 4);
+            assert(! buddy_is_empty(other));
+            assert(second.get() == 7);
+        }
+        assert(buddy_is_empty(other));
+        assert(buddy_alloc::coroutine_allocator::get() == allocator);
+
+        /* The frame outlives the binding */
+        task moved = std::move(first);
+        {
+            buddy_alloc::coroutine_allocator unbound(nullptr);
+            assert(moved.get() == 5);
+        }
+    }
+    assert(buddy_alloc::coroutine_allocator::get() == nullptr);
+    assert(buddy_is_empty(allocator));
+
+    /* Exhaustion is reported with an exception */
+    {
+        buddy_alloc::coroutine_allocator scope(allocator);
+        void *ptr = buddy_malloc(allocator, 4096);
+        bool thrown = false;
+        try {
+            task failed = add(1, 1);
+        } catch (const std::bad_alloc &) {
+            thrown = true;
+        }
+        assert(thrown);
+        buddy_free(allocator, ptr);
+    }
+
+    /* An arena that is less aligned than a frame */
+    allocator = buddy_init(buddy_buf, data_buf + 8, 2048);
+    {
+        buddy_alloc::coroutine_allocator scope(allocator);
+        bool thrown = false;
+        try {
+            task failed = add(1, 1);
+        } catch (const std::bad_alloc &) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(buddy_is_empty(allocator));
+    }
+    std::free(other_buf);
+    std::free(buddy_buf);
+}
+#else
+#define test_coroutine_allocator()
+#endif
+
 int main(int argc, char *argv[])
 {
     (void)argc;
     (void)argv;
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    test_allocator();
+    test_allocator_propagation();
+    test_realloc_typed();
+    test_arena();
+    test_unique_arena();
+    test_make_unique();
+    test_memory_resource();
+    test_coroutine_allocator();
+
     return 0;
-}
\ No newline at end of file
+}
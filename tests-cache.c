@@ -0,0 +1,248 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ */
+
+#define START_TEST printf("Running test: %s in %s:%d\n", __func__, __FILE__, __LINE__);
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUDDY_ALLOC_IMPLEMENTATION
+#define BUDDY_ALLOC_CACHE_IMPLEMENTATION
+#include "buddy_alloc_cache.h"
+#undef BUDDY_ALLOC_CACHE_IMPLEMENTATION
+#undef BUDDY_ALLOC_IMPLEMENTATION
+
+struct connection {
+    size_t state;
+    size_t uses;
+    char buffer[100];
+};
+
+static size_t constructed, destroyed;
+
+static void connection_ctor(void *object) {
+    struct connection *c = (struct connection *) object;
+    c->state = 42;
+    c->uses = 0;
+    memset(c->buffer, 'x', sizeof(c->buffer));
+    constructed++;
+}
+
+static void connection_dtor(void *object) {
+    struct connection *c = (struct connection *) object;
+    assert(c->state == 42);
+    destroyed++;
+}
+
+static size_t arena[(1 << 20) / sizeof(size_t)];
+
+struct buddy *cache_buddy(void) {
+    static size_t metadata[4096];
+    assert(buddy_sizeof(sizeof(arena)) <= sizeof(metadata));
+    return buddy_init((unsigned char *) metadata, (unsigned char *) arena, sizeof(arena));
+}
+
+void test_buddy_cache_create_invalid(void) {
+    struct buddy *buddy;
+    START_TEST;
+    buddy = cache_buddy();
+    assert(buddy_cache_create(NULL, 64, NULL, NULL) == NULL);
+    assert(buddy_cache_create(buddy, 0, NULL, NULL) == NULL);
+    assert(buddy_cache_create(buddy, SIZE_MAX, NULL, NULL) == NULL);
+    assert(buddy_cache_alloc(NULL) == NULL);
+    buddy_cache_free(NULL, arena);
+    buddy_cache_reap(NULL);
+    buddy_cache_destroy(NULL);
+    assert(buddy_is_empty(buddy));
+    /* Room for the cache but not for its magazines */
+    buddy = buddy_init((unsigned char *) arena, (unsigned char *) arena + 4096, 256);
+    assert(buddy_cache_create(buddy, 64, NULL, NULL) == NULL);
+    assert(buddy_is_empty(buddy));
+}
+
+void test_buddy_cache_constructed_state(void) {
+    struct buddy *buddy;
+    struct buddy_cache *cache;
+    struct connection *c;
+    size_t i;
+    START_TEST;
+    buddy = cache_buddy();
+    constructed = destroyed = 0;
+    cache = buddy_cache_create(buddy, sizeof(struct connection), connection_ctor, connection_dtor);
+    assert(cache != NULL);
+    buddy_cache_free(cache, NULL);
+
+    /* A slab of objects is constructed once */
+    c = buddy_cache_alloc(cache);
+    assert(c != NULL);
+    assert(c->state == 42);
+    assert(constructed > 1);
+    assert((((size_t) c) % sizeof(size_t)) == 0);
+    c->uses++;
+    buddy_cache_free(cache, c);
+
+    /* .. and reused without running the constructor again */
+    for (i = 0; i < 1000; i++) {
+        c = buddy_cache_alloc(cache);
+        assert(c->state == 42);
+        c->uses++;
+        buddy_cache_free(cache, c);
+    }
+    assert(c->uses == 1001);
+    assert(destroyed == 0);
+
+    buddy_cache_destroy(cache);
+    assert(destroyed == constructed);
+    assert(buddy_is_empty(buddy));
+}
+
+void test_buddy_cache_depot(void) {
+    struct buddy *buddy;
+    struct buddy_cache *cache;
+    void *objects[200];
+    size_t i, slabs;
+    START_TEST;
+    buddy = cache_buddy();
+    constructed = destroyed = 0;
+    cache = buddy_cache_create(buddy, sizeof(struct connection), connection_ctor, connection_dtor);
+
+    /* Spans several slabs and fills several magazines */
+    for (i = 0; i < 200; i++) {
+        objects[i] = buddy_cache_alloc(cache);
+        assert(objects[i] != NULL);
+        assert((i == 0) || (objects[i] != objects[i - 1]));
+    }
+    slabs = constructed;
+    for (i = 0; i < 200; i++) {
+        buddy_cache_free(cache, objects[i]);
+    }
+    /* Objects come back from the magazines and the depot */
+    for (i = 0; i < 200; i++) {
+        objects[i] = buddy_cache_alloc(cache);
+    }
+    assert(constructed == slabs);
+    /* Empty magazines from the depot are filled again */
+    for (i = 100; i < 200; i++) {
+        buddy_cache_free(cache, objects[i]);
+    }
+    for (i = 100; i < 200; i++) {
+        objects[i] = buddy_cache_alloc(cache);
+    }
+    /* Only empty magazines are in the depot now */
+    buddy_cache_reap(cache);
+    assert(destroyed == 0);
+    for (i = 0; i < 200; i++) {
+        buddy_cache_free(cache, objects[i]);
+    }
+
+    /* Reaping destroys the objects in the depot and releases empty slabs */
+    buddy_cache_reap(cache);
+    assert(destroyed > 0);
+    assert(destroyed < constructed);
+    for (i = 0; i < 200; i++) {
+        objects[i] = buddy_cache_alloc(cache);
+        assert(((struct connection *) objects[i])->state == 42);
+    }
+    for (i = 0; i < 200; i++) {
+        buddy_cache_free(cache, objects[i]);
+    }
+    buddy_cache_destroy(cache);
+    assert(destroyed == constructed);
+    assert(buddy_is_empty(buddy));
+}
+
+void test_buddy_cache_large_objects(void) {
+    struct buddy *buddy;
+    struct buddy_cache *cache;
+    unsigned char *a, *b;
+    START_TEST;
+    buddy = cache_buddy();
+    /* Slabs grow to hold at least eight objects */
+    cache = buddy_cache_create(buddy, 5000, NULL, NULL);
+    a = buddy_cache_alloc(cache);
+    b = buddy_cache_alloc(cache);
+    assert((a != NULL) && (b != NULL));
+    assert((size_t) (b - a) >= 5000);
+    memset(a, 1, 5000);
+    memset(b, 2, 5000);
+    buddy_cache_free(cache, a);
+    buddy_cache_free(cache, b);
+    buddy_cache_destroy(cache);
+    assert(buddy_is_empty(buddy));
+}
+
+void test_buddy_cache_alignment(void) {
+    struct buddy *buddy;
+    struct buddy_cache *cache;
+    void *objects[64];
+    size_t size, i;
+    START_TEST;
+    buddy = cache_buddy();
+    for (size = 1; size <= 40; size++) {
+        cache = buddy_cache_create(buddy, size, NULL, NULL);
+        for (i = 0; i < 64; i++) {
+            objects[i] = buddy_cache_alloc(cache);
+            /* Relative to the arena, whose own alignment is up to the platform */
+            assert((((uintptr_t) objects[i] - (uintptr_t) arena) % BUDDY_CACHE_ALIGN) == 0);
+            memset(objects[i], 0xff, size);
+        }
+        for (i = 0; i < 64; i++) {
+            buddy_cache_free(cache, objects[i]);
+        }
+        buddy_cache_destroy(cache);
+        assert(buddy_is_empty(buddy));
+    }
+}
+
+void test_buddy_cache_exhausted(void) {
+    struct buddy *buddy;
+    struct buddy_cache *cache;
+    void *object, *objects[256];
+    size_t count, i;
+    START_TEST;
+    buddy = cache_buddy();
+    cache = buddy_cache_create(buddy, 1000, NULL, NULL);
+    assert(cache != NULL);
+    /* Leave room for a few slabs */
+    assert(buddy_malloc(buddy, sizeof(arena) / 2) != NULL);
+    assert(buddy_malloc(buddy, sizeof(arena) / 4) != NULL);
+    assert(buddy_malloc(buddy, sizeof(arena) / 8) != NULL);
+    for (count = 0; count < 256; count++) {
+        objects[count] = buddy_cache_alloc(cache);
+        if (objects[count] == NULL) {
+            break;
+        }
+    }
+    assert((count > 0) && (count < 256));
+    assert(buddy_cache_alloc(cache) == NULL);
+    /* Without room for more magazines objects go back to their slabs */
+    while (buddy_malloc(buddy, 1)) {
+    }
+    for (i = 0; i < count; i++) {
+        buddy_cache_free(cache, objects[i]);
+    }
+    object = buddy_cache_alloc(cache);
+    assert(object != NULL);
+    buddy_cache_free(cache, object);
+    buddy_cache_destroy(cache);
+    while (buddy_malloc(buddy, 1)) {
+    }
+    assert(buddy_cache_create(buddy, 64, NULL, NULL) == NULL);
+}
+
+int main(void) {
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    test_buddy_cache_create_invalid();
+    test_buddy_cache_constructed_state();
+    test_buddy_cache_depot();
+    test_buddy_cache_large_objects();
+    test_buddy_cache_alignment();
+    test_buddy_cache_exhausted();
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ */
+
+#define START_TEST printf("Running test: %s in %s:%d\n", __func__, __FILE__, __LINE__);
+#define _DEFAULT_SOURCE
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUDDY_ALLOC_IMPLEMENTATION
+#define BUDDY_ALLOC_IOBUF_IMPLEMENTATION
+#include "buddy_alloc_iobuf.h"
+#undef BUDDY_ALLOC_IOBUF_IMPLEMENTATION
+#undef BUDDY_ALLOC_IMPLEMENTATION
+
+void test_buddy_iobuf_create_invalid(void) {
+    START_TEST;
+    assert(buddy_iobuf_create(0, 0) == NULL);
+    assert(buddy_iobuf_create(SIZE_MAX, 0) == NULL);
+    /* Larger than the address space */
+    assert(buddy_iobuf_create(SIZE_MAX / 8, 0) == NULL);
+    buddy_iobuf_destroy(NULL);
+    assert(buddy_iobuf_get(NULL, 4096) == NULL);
+    buddy_iobuf_put(NULL, NULL);
+    assert(buddy_iobuf_size(NULL, NULL) == 0);
+    assert(buddy_iobuf_page_size(NULL) == 0);
+}
+
+void test_buddy_iobuf_buffers(void) {
+    struct buddy_iobuf_pool *pool;
+    unsigned char *a, *b, *c;
+    size_t page;
+    START_TEST;
+    pool = buddy_iobuf_create(1 << 20, 0);
+    assert(pool != NULL);
+    page = buddy_iobuf_page_size(pool);
+    assert(page > 0);
+    assert(buddy_iobuf_get(pool, 0) == NULL);
+
+    /* Buffers are page-aligned and of power-of-two sizes of at least a page */
+    a = buddy_iobuf_get(pool, 1);
+    b = buddy_iobuf_get(pool, page + 1);
+    c = buddy_iobuf_get(pool, 65536);
+    assert((a != NULL) && (b != NULL) && (c != NULL));
+    assert(((uintptr_t) a % page) == 0);
+    assert(((uintptr_t) b % page) == 0);
+    assert(((uintptr_t) c % page) == 0);
+    assert(buddy_iobuf_size(pool, a) == page);
+    assert(buddy_iobuf_size(pool, b) == (2 * page));
+    assert(buddy_iobuf_size(pool, c) == ((page > 65536) ? page : 65536));
+    assert(buddy_iobuf_size(pool, a + 1) == 0);
+    memset(a, 1, page);
+    memset(b, 2, 2 * page);
+    memset(c, 3, 65536);
+
+    /* The arena is rounded up to a power of two */
+    assert(buddy_iobuf_get(pool, 1 << 20) == NULL);
+    buddy_iobuf_put(pool, a);
+    buddy_iobuf_put(pool, b);
+    buddy_iobuf_put(pool, c);
+    buddy_iobuf_put(pool, NULL);
+    a = buddy_iobuf_get(pool, 1 << 20);
+    assert(a != NULL);
+    assert(buddy_iobuf_get(pool, 1) == NULL);
+    buddy_iobuf_put(pool, a);
+    buddy_iobuf_destroy(pool);
+
+    pool = buddy_iobuf_create(3 * page, 0);
+    assert(buddy_iobuf_size(pool, buddy_iobuf_get(pool, 4 * page)) == (4 * page));
+    buddy_iobuf_destroy(pool);
+}
+
+void test_buddy_iobuf_prefault(void) {
+    struct buddy_iobuf_pool *pool;
+    unsigned char *a;
+    START_TEST;
+    pool = buddy_iobuf_create(1 << 20, BUDDY_IOBUF_PREFAULT);
+    assert(pool != NULL);
+    a = buddy_iobuf_get(pool, 1 << 16);
+    assert(a[0] == 0);
+    memset(a, 1, 1 << 16);
+    buddy_iobuf_put(pool, a);
+    buddy_iobuf_destroy(pool);
+
+    /* Locking can be refused by the memory lock limit */
+    pool = buddy_iobuf_create(1 << 16, BUDDY_IOBUF_LOCK);
+    if (pool != NULL) {
+        a = buddy_iobuf_get(pool, 1 << 16);
+        assert(a != NULL);
+        buddy_iobuf_put(pool, a);
+        buddy_iobuf_destroy(pool);
+    }
+}
+
+int main(void) {
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    test_buddy_iobuf_create_invalid();
+    test_buddy_iobuf_buffers();
+    test_buddy_iobuf_prefault();
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ */
+
+#define START_TEST printf("Running test: %s in %s:%d\n", __func__, __FILE__, __LINE__);
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUDDY_ALLOC_IMPLEMENTATION
+#define BUDDY_ALLOC_MULTI_IMPLEMENTATION
+#include "buddy_alloc_multi.h"
+#undef BUDDY_ALLOC_MULTI_IMPLEMENTATION
+#undef BUDDY_ALLOC_IMPLEMENTATION
+
+#define ARENA_SIZE (1 << 20)
+
+static size_t metadata[8192];
+/* Over-allocated by a page, main aligns the arena to it at run time */
+static unsigned char arena_buf[ARENA_SIZE + 4096];
+static unsigned char *arena;
+
+void test_buddy_multi_sizeof(void) {
+    START_TEST;
+    assert(buddy_multi_sizeof(0, 0, 0) == 0);
+    assert(buddy_multi_arena_size(0, 0, 0) == 0);
+    /* Arenas are trimmed down to their alignment */
+    assert(buddy_multi_sizeof(15, 255, 4095) == 0);
+    assert(buddy_multi_arena_size(4096, 0, 0) == 4096);
+    assert(buddy_multi_arena_size(100, 1000, 5000) == (4096 + 4096));
+    assert(buddy_multi_arena_size(4096, 4096, 4096) == (3 * 4096));
+    /* Each class carries the metadata of its own alignment */
+    assert(buddy_multi_sizeof(0, 0, 1 << 20) < buddy_multi_sizeof(0, 1 << 20, 0));
+    assert(buddy_multi_sizeof(0, 1 << 20, 0) < buddy_multi_sizeof(1 << 20, 0, 0));
+    assert(buddy_multi_sizeof(1 << 16, 1 << 16, 1 << 16)
+        > (buddy_sizeof_alignment(1 << 16, 16) + buddy_sizeof_alignment(1 << 16, 256)
+            + buddy_sizeof_alignment(1 << 16, 4096)));
+}
+
+void test_buddy_multi_init(void) {
+    START_TEST;
+    assert(buddy_multi_init(NULL, arena, 4096, 4096, 4096) == NULL);
+    assert(buddy_multi_init((unsigned char *) metadata, NULL, 4096, 4096, 4096) == NULL);
+    assert(buddy_multi_init((unsigned char *) metadata, arena, 0, 0, 0) == NULL);
+    assert(buddy_multi_init((unsigned char *) metadata + 1, arena, 4096, 4096, 4096) == NULL);
+    /* Misaligned arenas are rejected by the allocators */
+    assert(buddy_multi_init((unsigned char *) metadata, arena + 1, 4096, 4096, 4096) == NULL);
+    assert(buddy_multi_init((unsigned char *) metadata, arena, 4096, 4096, 4096) != NULL);
+}
+
+void test_buddy_multi_routing(void) {
+    struct buddy_multi *multi;
+    unsigned char *small, *medium, *large;
+    START_TEST;
+    assert(buddy_multi_sizeof(1 << 16, 1 << 18, 1 << 19) <= sizeof(metadata));
+    assert(buddy_multi_arena_size(1 << 16, 1 << 18, 1 << 19) <= ARENA_SIZE);
+    multi = buddy_multi_init((unsigned char *) metadata, arena, 1 << 16, 1 << 18, 1 << 19);
+    assert(multi != NULL);
+
+    small = buddy_multi_malloc(multi, 24);
+    medium = buddy_multi_malloc(multi, 300);
+    large = buddy_multi_malloc(multi, 5000);
+    assert(small == arena);
+    assert(medium == (arena + (1 << 16)));
+    assert(large == (arena + (1 << 16) + (1 << 18)));
+    assert(buddy_usable_size(buddy_multi_buddy(multi, small), small) == 32);
+    assert(buddy_usable_size(buddy_multi_buddy(multi, medium), medium) == 512);
+    assert(buddy_usable_size(buddy_multi_buddy(multi, large), large) == 8192);
+    assert(((uintptr_t) large % 4096) == 0);
+
+    /* Boundaries of the size classes */
+    buddy_multi_free(multi, small);
+    small = buddy_multi_malloc(multi, 255);
+    assert(buddy_multi_buddy(multi, small) == buddy_multi_buddy(multi, arena));
+    buddy_multi_free(multi, small);
+    small = buddy_multi_malloc(multi, 256);
+    assert(buddy_multi_buddy(multi, small) == buddy_multi_buddy(multi, medium));
+    buddy_multi_free(multi, small);
+    small = buddy_multi_malloc(multi, 4096);
+    assert(buddy_multi_buddy(multi, small) == buddy_multi_buddy(multi, large));
+    buddy_multi_free(multi, small);
+
+    buddy_multi_free(multi, medium);
+    buddy_multi_free(multi, large);
+    assert(buddy_is_empty(buddy_multi_buddy(multi, arena)));
+    assert(buddy_is_empty(buddy_multi_buddy(multi, medium)));
+    assert(buddy_is_empty(buddy_multi_buddy(multi, large)));
+}
+
+void test_buddy_multi_fallback(void) {
+    struct buddy_multi *multi;
+    unsigned char *first, *second;
+    START_TEST;
+    /* Without a small class */
+    multi = buddy_multi_init((unsigned char *) metadata, arena, 0, 4096, 4096);
+    assert(multi != NULL);
+    first = buddy_multi_malloc(multi, 1);
+    assert(first == arena);
+    assert(buddy_usable_size(buddy_multi_buddy(multi, first), first) == 256);
+
+    /* Exhausted classes spill over to the larger ones */
+    second = buddy_multi_malloc(multi, 3000);
+    assert(second == (arena + 4096));
+    buddy_multi_free(multi, second);
+    assert(buddy_multi_malloc(multi, 2048) == (arena + 2048));
+    assert(buddy_multi_malloc(multi, 1024) == (arena + 1024));
+    assert(buddy_multi_malloc(multi, 1024) == (arena + 4096));
+    assert(buddy_multi_malloc(multi, 1) == (arena + 256));
+    /* .. but not to the smaller ones */
+    buddy_multi_free(multi, first);
+    assert(buddy_multi_malloc(multi, 4096) == NULL);
+    assert(buddy_multi_malloc(multi, 8192) == NULL);
+    assert(buddy_multi_malloc(NULL, 1) == NULL);
+}
+
+void test_buddy_multi_free_dispatch(void) {
+    struct buddy_multi *multi;
+    unsigned char *ptr;
+    START_TEST;
+    multi = buddy_multi_init((unsigned char *) metadata, arena, 4096, 0, 8192);
+    ptr = buddy_multi_malloc(multi, 64);
+    assert(ptr == arena);
+    /* Addresses outside of the arenas are ignored */
+    buddy_multi_free(multi, NULL);
+    buddy_multi_free(NULL, ptr);
+    buddy_multi_free(multi, arena + 4096 + 8192);
+    buddy_multi_free(multi, metadata);
+    assert(buddy_multi_buddy(multi, arena + 4096 + 8192) == NULL);
+    assert(buddy_multi_buddy(NULL, ptr) == NULL);
+    assert(! buddy_is_empty(buddy_multi_buddy(multi, ptr)));
+    buddy_multi_free(multi, ptr);
+    assert(buddy_is_empty(buddy_multi_buddy(multi, ptr)));
+}
+
+int main(void) {
+    setvbuf(stdout, NULL, _IONBF, 0);
+    arena = arena_buf + ((4096 - ((uintptr_t) arena_buf % 4096)) % 4096);
+
+    test_buddy_multi_sizeof();
+    test_buddy_multi_init();
+    test_buddy_multi_routing();
+    test_buddy_multi_fallback();
+    test_buddy_multi_free_dispatch();
+
+    return 0;
+}
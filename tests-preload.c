@@ -0,0 +1,213 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ *
+ * Run with LD_PRELOAD set to the library built from buddy_alloc_preload.c
+ */
+
+#define START_TEST printf("Running test: %s in %s:%d\n", __func__, __FILE__, __LINE__);
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern void *__libc_malloc(size_t size);
+
+/* Functions called through volatile pointers are not folded away by the compiler */
+static void *(*volatile malloc_fn)(size_t) = malloc;
+static void *(*volatile calloc_fn)(size_t, size_t) = calloc;
+static void *(*volatile realloc_fn)(void *, size_t) = realloc;
+
+void test_preload_malloc(void) {
+    unsigned char *small, *large;
+    START_TEST;
+    /* Sizes are rounded up to the slab classes and to the buddy slots */
+    small = malloc_fn(100);
+    assert(small != NULL);
+    assert(((uintptr_t) small % 16) == 0);
+    assert(malloc_usable_size(small) == 128);
+    large = malloc_fn(1000);
+    assert(large != NULL);
+    assert(malloc_usable_size(large) == 1024);
+    memset(small, 1, 128);
+    memset(large, 2, 1024);
+    free(small);
+    free(large);
+    free(NULL);
+    assert(malloc_usable_size(NULL) == 0);
+    small = malloc_fn(0);
+    assert(small != NULL);
+    free(small);
+}
+
+void test_preload_slab_reuse(void) {
+    void *objects[1000];
+    void *again;
+    size_t i;
+    START_TEST;
+    for (i = 0; i < 1000; i++) {
+        objects[i] = malloc_fn(32);
+        assert(objects[i] != NULL);
+        memset(objects[i], (int) i, 32);
+    }
+    for (i = 0; i < 1000; i++) {
+        assert(*(unsigned char *) objects[i] == (unsigned char) i);
+    }
+    free(objects[500]);
+    again = malloc_fn(32);
+    assert(again == objects[500]);
+    objects[500] = again;
+    for (i = 0; i < 1000; i++) {
+        free(objects[i]);
+    }
+}
+
+void test_preload_calloc(void) {
+    unsigned char *first, *second;
+    size_t i;
+    START_TEST;
+    first = malloc_fn(4096);
+    memset(first, 0xFF, 4096);
+    free(first);
+    second = calloc_fn(64, 64);
+    assert(second != NULL);
+    for (i = 0; i < 4096; i++) {
+        assert(second[i] == 0);
+    }
+    free(second);
+    errno = 0;
+    assert(calloc_fn(SIZE_MAX / 2, 3) == NULL);
+    assert(errno == ENOMEM);
+}
+
+void test_preload_realloc(void) {
+    unsigned char *data, *moved;
+    size_t i;
+    START_TEST;
+    data = realloc_fn(NULL, 20);
+    assert(data != NULL);
+    for (i = 0; i < 20; i++) {
+        data[i] = (unsigned char) i;
+    }
+    /* Within the slab object */
+    moved = realloc_fn(data, 32);
+    assert(moved == data);
+    /* Out of the slab */
+    moved = realloc_fn(data, 5000);
+    assert(moved != NULL);
+    assert(malloc_usable_size(moved) == 8192);
+    for (i = 0; i < 20; i++) {
+        assert(moved[i] == (unsigned char) i);
+    }
+    /* Shrinking in place */
+    data = realloc_fn(moved, 3000);
+    assert(data == moved);
+    assert(malloc_usable_size(data) == 4096);
+    for (i = 0; i < 20; i++) {
+        assert(data[i] == (unsigned char) i);
+    }
+    assert(realloc_fn(data, 0) == NULL);
+}
+
+void test_preload_aligned(void) {
+    void *ptr = NULL;
+    START_TEST;
+    assert(posix_memalign(&ptr, 3, 64) == EINVAL);
+    assert(posix_memalign(&ptr, 4096, 100) == 0);
+    assert(((uintptr_t) ptr % 4096) == 0);
+    free(ptr);
+    ptr = aligned_alloc(1 << 16, 10);
+    assert(((uintptr_t) ptr % (1 << 16)) == 0);
+    free(ptr);
+    ptr = memalign(64, 10);
+    assert(((uintptr_t) ptr % 64) == 0);
+    free(ptr);
+    ptr = valloc(1);
+    assert(((uintptr_t) ptr % 4096) == 0);
+    free(ptr);
+    ptr = pvalloc(4097);
+    assert(((uintptr_t) ptr % 4096) == 0);
+    assert(malloc_usable_size(ptr) == 8192);
+    free(ptr);
+}
+
+void test_preload_foreign_free(void) {
+    void *ptr;
+    START_TEST;
+    /* Pointers from the glibc allocator are passed back to it */
+    ptr = __libc_malloc(100);
+    assert(ptr != NULL);
+    assert(malloc_usable_size(ptr) >= 100);
+    ptr = realloc_fn(ptr, 200);
+    assert(malloc_usable_size(ptr) >= 200);
+    free(ptr);
+}
+
+static void *thread_work(void *arg) {
+    void *slots[256];
+    size_t i, round;
+    for (round = 0; round < 200; round++) {
+        for (i = 0; i < 256; i++) {
+            slots[i] = malloc_fn(((i * 37) + round) % 2048 + 1);
+            assert(slots[i] != NULL);
+            memset(slots[i], (int) i, 1);
+        }
+        for (i = 0; i < 256; i++) {
+            assert(*(unsigned char *) slots[i] == (unsigned char) i);
+            free(slots[i]);
+        }
+    }
+    return arg;
+}
+
+void test_preload_threads(void) {
+    pthread_t threads[16];
+    size_t i;
+    START_TEST;
+    for (i = 0; i < 16; i++) {
+        assert(pthread_create(&threads[i], NULL, thread_work, NULL) == 0);
+    }
+    for (i = 0; i < 16; i++) {
+        assert(pthread_join(threads[i], NULL) == 0);
+    }
+}
+
+void test_preload_fork(void) {
+    void *ptr;
+    pid_t child;
+    int status;
+    START_TEST;
+    ptr = malloc_fn(100);
+    child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        free(ptr);
+        ptr = malloc_fn(100);
+        _exit(ptr == NULL);
+    }
+    assert(waitpid(child, &status, 0) == child);
+    assert(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+    free(ptr);
+}
+
+int main(void) {
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    test_preload_malloc();
+    test_preload_slab_reuse();
+    test_preload_calloc();
+    test_preload_realloc();
+    test_preload_aligned();
+    test_preload_foreign_free();
+    test_preload_threads();
+    test_preload_fork();
+
+    return 0;
+}
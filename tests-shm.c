@@ -0,0 +1,202 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ */
+
+#define START_TEST printf("Running test: %s in %s:%d\n", __func__, __FILE__, __LINE__);
+#define _XOPEN_SOURCE 700
+
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BUDDY_ALLOC_IMPLEMENTATION
+#define BUDDY_ALLOC_SHM_IMPLEMENTATION
+#include "buddy_alloc_shm.h"
+#undef BUDDY_ALLOC_SHM_IMPLEMENTATION
+#undef BUDDY_ALLOC_IMPLEMENTATION
+
+/* Returns an anonymous shared memory object */
+int shm_fd(void) {
+    char name[64];
+    int fd;
+    snprintf(name, sizeof(name), "/buddy_alloc_tests_%ld", (long) getpid());
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    assert(fd >= 0);
+    shm_unlink(name);
+    return fd;
+}
+
+void test_buddy_shm_create_invalid(void) {
+    int fd;
+    START_TEST;
+    assert(buddy_shm_create(-1, 65536) == NULL);
+    fd = shm_fd();
+    assert(buddy_shm_create(fd, 1) == NULL);
+    assert(buddy_shm_create(fd, 128) == NULL);
+    close(fd);
+}
+
+void test_buddy_shm_attach_invalid(void) {
+    int fd;
+    START_TEST;
+    assert(buddy_shm_attach(-1) == NULL);
+    fd = shm_fd();
+    assert(buddy_shm_attach(fd) == NULL);
+    assert(ftruncate(fd, 65536) == 0);
+    /* Not initialized */
+    assert(buddy_shm_attach(fd) == NULL);
+    close(fd);
+    buddy_shm_detach(NULL);
+}
+
+void test_buddy_shm_handles(void) {
+    struct buddy_shm *shm, *other;
+    size_t a, b;
+    int fd;
+    START_TEST;
+    fd = shm_fd();
+    shm = buddy_shm_create(fd, 65536);
+    assert(shm != NULL);
+    other = buddy_shm_attach(fd);
+    assert(other != NULL);
+    assert(other != shm);
+
+    a = buddy_shm_malloc(shm, 1024);
+    assert(a != 0);
+    strcpy(buddy_shm_pointer(shm, a), "shared");
+    /* The same handle refers to the same memory in another mapping */
+    assert(strcmp(buddy_shm_pointer(other, a), "shared") == 0);
+    assert(buddy_shm_handle(other, buddy_shm_pointer(other, a)) == a);
+    b = buddy_shm_malloc(other, 1024);
+    assert(b != 0);
+    assert(b != a);
+
+    assert(buddy_shm_pointer(shm, 0) == NULL);
+    assert(buddy_shm_pointer(shm, 65536) == NULL);
+    assert(buddy_shm_handle(shm, NULL) == 0);
+    assert(buddy_shm_handle(shm, shm) == 0);
+    assert(buddy_shm_handle(shm, (unsigned char *) shm + 65536) == 0);
+    assert(buddy_shm_malloc(shm, 65536) == 0);
+    assert(buddy_shm_malloc(NULL, 64) == 0);
+    buddy_shm_free(NULL, a);
+
+    buddy_shm_free(other, a);
+    buddy_shm_free(shm, b);
+    buddy_shm_free(shm, 0);
+    assert(buddy_is_empty(buddy_shm_lock(shm)));
+    buddy_shm_unlock(shm);
+
+    buddy_shm_detach(other);
+    buddy_shm_detach(shm);
+    close(fd);
+}
+
+void test_buddy_shm_processes(void) {
+    struct buddy_shm *shm;
+    size_t *slot;
+    size_t handle;
+    int fd, status;
+    pid_t pid;
+    START_TEST;
+    fd = shm_fd();
+    shm = buddy_shm_create(fd, 65536);
+    assert(shm != NULL);
+    handle = buddy_shm_malloc(shm, sizeof(size_t));
+    slot = buddy_shm_pointer(shm, handle);
+    *slot = 0;
+
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        /* Allocate in the child and pass the handle back through shared memory */
+        struct buddy_shm *child = buddy_shm_attach(fd);
+        size_t data = buddy_shm_malloc(child, 64);
+        strcpy(buddy_shm_pointer(child, data), "from child");
+        *(size_t *) buddy_shm_pointer(child, handle) = data;
+        _exit(0);
+    }
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+    assert(*slot != 0);
+    assert(strcmp(buddy_shm_pointer(shm, *slot), "from child") == 0);
+    buddy_shm_free(shm, *slot);
+    buddy_shm_free(shm, handle);
+    assert(buddy_is_empty(buddy_shm_lock(shm)));
+    buddy_shm_unlock(shm);
+
+    buddy_shm_detach(shm);
+    close(fd);
+}
+
+void test_buddy_shm_owner_died(void) {
+    struct buddy_shm *shm;
+    struct buddy *buddy;
+    struct buddy_tree *tree;
+    size_t free_size;
+    int fd, status;
+    pid_t pid;
+    START_TEST;
+    fd = shm_fd();
+    shm = buddy_shm_create(fd, 65536);
+    assert(shm != NULL);
+
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        /* Exit while holding the lock */
+        buddy_shm_lock(shm);
+        _exit(0);
+    }
+    assert(waitpid(pid, &status, 0) == pid);
+
+    /* The lock is recovered */
+    assert(buddy_shm_malloc(shm, 64) != 0);
+    assert(buddy_shm_malloc(shm, 64) != 0);
+    free_size = buddy_arena_free_size(buddy_shm_lock(shm));
+    buddy_shm_unlock(shm);
+
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        /* Get killed in the middle of an allocation, its parents are not updated */
+        buddy = buddy_shm_lock(shm);
+        tree = buddy_tree(buddy);
+        write_to_internal_position(tree, buddy_tree_internal_position_tree(tree,
+            deepest_position_for_offset(buddy, 32768)), 1);
+        kill(getpid(), SIGKILL);
+        _exit(0);
+    }
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFSIGNALED(status) && (WTERMSIG(status) == SIGKILL));
+
+    /* The allocator is rebuilt for the next owner */
+    buddy = buddy_shm_lock(shm);
+    assert(buddy != NULL);
+    tree = buddy_tree(buddy);
+    assert(buddy_tree_check_invariant(tree, buddy_tree_root()) == 0);
+    /* The slot that was marked is kept */
+    assert(buddy_arena_free_size(buddy) == (free_size - buddy_alignment(buddy)));
+    assert(buddy_usable_size(buddy, buddy_main(buddy) + 32768) == buddy_alignment(buddy));
+    buddy_shm_unlock(shm);
+
+    buddy_shm_detach(shm);
+    close(fd);
+}
+
+int main(void) {
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    test_buddy_shm_create_invalid();
+    test_buddy_shm_attach_invalid();
+    test_buddy_shm_handles();
+    test_buddy_shm_processes();
+    test_buddy_shm_owner_died();
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2026 Stanislav Paskalev <spaskalev@protonmail.com>
+ */
+
+#define START_TEST printf("Running test: %s in %s:%d\n", __func__, __FILE__, __LINE__);
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUDDY_STATIC_ORDER 7
+#define BUDDY_STATIC_ALIGNMENT 64
+#define BUDDY_ALLOC_IMPLEMENTATION
+#include "buddy_alloc.h"
+#undef BUDDY_ALLOC_IMPLEMENTATION
+
+/* Metadata for the largest arena of the static configuration, in .bss */
+#define METADATA_SIZE BUDDY_METADATA_SIZE(BUDDY_STATIC_ORDER, BUDDY_STATIC_ALIGNMENT)
+static size_t metadata[(METADATA_SIZE + sizeof(size_t) - 1) / sizeof(size_t)];
+static size_t arena[4096 / sizeof(size_t)];
+
+void test_buddy_static_sizeof(void) {
+    START_TEST;
+    assert(buddy_sizeof(4096) == METADATA_SIZE);
+    assert(buddy_sizeof(2112) == METADATA_SIZE);
+    /* Tree orders other than the static one */
+    assert(buddy_sizeof(2048) == 0);
+    assert(buddy_sizeof(8192) == 0);
+    /* Alignments other than the static one */
+    assert(buddy_sizeof_alignment(4096, 32) == 0);
+    assert(buddy_sizeof_alignment(8192, 128) == 0);
+}
+
+void test_buddy_static_init(void) {
+    struct buddy *buddy;
+    START_TEST;
+    assert(buddy_init((unsigned char *) metadata, (unsigned char *) arena, 2048) == NULL);
+    assert(buddy_init_alignment((unsigned char *) metadata, (unsigned char *) arena, 8192, 128) == NULL);
+    assert(buddy_embed((unsigned char *) arena, 2048) == NULL);
+    buddy = buddy_init((unsigned char *) metadata, (unsigned char *) arena, 4096);
+    assert(buddy != NULL);
+    assert(buddy_arena_size(buddy) == 4096);
+    assert(buddy_is_empty(buddy));
+}
+
+void test_buddy_static_malloc(void) {
+    struct buddy *buddy;
+    void *slots[64];
+    size_t i;
+    START_TEST;
+    buddy = buddy_init((unsigned char *) metadata, (unsigned char *) arena, 4096);
+    assert(buddy_malloc(buddy, 4096) == arena);
+    assert(buddy_is_full(buddy));
+    buddy_free(buddy, arena);
+    for (i = 0; i < 64; i++) {
+        slots[i] = buddy_malloc(buddy, 1);
+        assert(slots[i] == (unsigned char *) arena + (i * 64));
+    }
+    assert(buddy_malloc(buddy, 1) == NULL);
+    for (i = 0; i < 64; i++) {
+        assert(buddy_safe_free(buddy, slots[i], 1) == BUDDY_SAFE_FREE_SUCCESS);
+    }
+    assert(buddy_is_empty(buddy));
+    assert(buddy_arena_free_size(buddy) == 4096);
+}
+
+void test_buddy_static_virtual_slots(void) {
+    struct buddy *buddy;
+    START_TEST;
+    /* A smaller arena of the same tree order */
+    buddy = buddy_init((unsigned char *) metadata, (unsigned char *) arena, 3072);
+    assert(buddy != NULL);
+    assert(buddy_arena_free_size(buddy) == 3072);
+    assert(buddy_malloc(buddy, 2048) == arena);
+    assert(buddy_malloc(buddy, 2048) == NULL);
+    assert(buddy_malloc(buddy, 1024) == (unsigned char *) arena + 2048);
+    assert(buddy_is_full(buddy));
+}
+
+void test_buddy_static_resize(void) {
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init((unsigned char *) metadata, (unsigned char *) arena, 4096);
+    assert(buddy_malloc(buddy, 64) == arena);
+    /* Resizing within the tree order works */
+    assert(buddy_resize(buddy, 2112) == buddy);
+    assert(buddy_arena_size(buddy) == 2112);
+    assert(buddy_resize(buddy, 4096) == buddy);
+    /* .. and fails otherwise */
+    assert(buddy_resize(buddy, 2048) == NULL);
+    assert(buddy_resize(buddy, 8192) == NULL);
+    assert(buddy_arena_size(buddy) == 4096);
+    buddy_free(buddy, arena);
+    assert(buddy_is_empty(buddy));
+}
+
+int main(void) {
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    test_buddy_static_sizeof();
+    test_buddy_static_init();
+    test_buddy_static_malloc();
+    test_buddy_static_virtual_slots();
+    test_buddy_static_resize();
+
+    return 0;
+}
@@ -11,6 +11,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef _MSC_VER
+#include <sys/uio.h>
+#endif
 
 #define BUDDY_ALLOC_IMPLEMENTATION
 #include "buddy_alloc.h"
@@ -34,6 +37,18 @@
 #error Unsupported platform
 #endif
 
+/*
+ * Returns the smallest size for buddy_embed that leaves at least arena_size bytes
+ * for the arena. Experimental features change the size and layout of the metadata.
+ */
+size_t embedded_size(size_t arena_size) {
+    size_t size = arena_size + buddy_sizeof(arena_size);
+    while (buddy_embed_offset(size, BUDDY_ALLOC_ALIGN).offset < arena_size) {
+        size++;
+    }
+    return size;
+}
+
 /*
  * This is a mini-hack for Windows, that allows us to quick-fail on assertions
  */
@@ -255,6 +270,23 @@ void test_buddy_invalid_datasize(void) {
     free(buddy_buf);
 }
 
+void test_buddy_metadata_size(void) {
+    /* Static storage sized at compile time */
+    static size_t metadata[BUDDY_METADATA_SIZE(7, 64) / sizeof(size_t) + 1];
+    static size_t data_buf[4096 / sizeof(size_t)];
+    struct buddy *buddy;
+    START_TEST;
+    for (size_t order = 1; order <= 20; order++) {
+        for (size_t alignment = 1; alignment <= 8192; alignment *= 2) {
+            assert(BUDDY_METADATA_SIZE(order, alignment)
+                == buddy_sizeof_alignment(alignment << (order - 1), alignment));
+        }
+    }
+    buddy = buddy_init_alignment((unsigned char *) metadata, (unsigned char *) data_buf, 4096, 64);
+    assert(buddy != NULL);
+    assert(buddy_malloc(buddy, 4096) == (void *) data_buf);
+}
+
 void test_buddy_init(void) {
     unsigned char data_buf[4096];
     unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
@@ -409,6 +441,23 @@ void test_buddy_resize_down_within_reserved(void) {
     free(buddy_buf);
 }
 
+void test_buddy_resize_down_keeps_allocations(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(8192, 64));
+    unsigned char data_buf[8192];
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 8192, 64);
+    assert(buddy_malloc(buddy, 64) == data_buf);
+    assert(buddy_malloc(buddy, 256) == data_buf + 256);
+    assert(buddy_resize(buddy, 2048) == buddy);
+    assert(buddy_arena_free_size(buddy) == 2048 - 64 - 256);
+    assert(buddy_tree_check_invariant(buddy_tree(buddy), buddy_tree_root()) == 0);
+    buddy_free(buddy, data_buf);
+    buddy_free(buddy, data_buf + 256);
+    assert(buddy_is_empty(buddy));
+    free(buddy_buf);
+}
+
 void test_buddy_resize_down_within_reserved_failure(void) {
     unsigned char *buddy_buf = malloc(buddy_sizeof(1024));
     unsigned char data_buf[1024];
@@ -485,9 +534,9 @@ void test_buddy_resize_embedded_up_within_reserved(void) {
     unsigned char data_buf[4096];
     struct buddy *buddy;
     START_TEST;
-    buddy = buddy_embed(data_buf, 768 + buddy_sizeof(768));
+    buddy = buddy_embed(data_buf, embedded_size(768));
     assert(buddy != NULL);
-    buddy = buddy_resize(buddy, 896 + buddy_sizeof(896));
+    buddy = buddy_resize(buddy, embedded_size(896));
     assert(buddy != NULL);
     assert(buddy_malloc(buddy, 512) == data_buf);
     assert(buddy_malloc(buddy, 256) == data_buf+512);
@@ -503,10 +552,10 @@ void test_buddy_resize_embedded_up_at_reserved(void) {
     unsigned char data_buf[4096];
     struct buddy *buddy;
     START_TEST;
-    buddy = buddy_embed(data_buf, 768 + buddy_sizeof(768));
+    buddy = buddy_embed(data_buf, embedded_size(768));
     assert(buddy != NULL);
     assert(buddy_malloc(buddy, 1024) == NULL);
-    buddy = buddy_resize(buddy, 1024 + (sizeof(size_t)*OF(4,5)) + buddy_sizeof(1024));
+    buddy = buddy_resize(buddy, embedded_size(1024));
     assert(buddy != NULL);
     assert(buddy_malloc(buddy, 1024) == data_buf);
     assert(buddy_malloc(buddy, 1024) == NULL);
@@ -516,10 +565,10 @@ void test_buddy_resize_embedded_up_after_reserved(void) {
     unsigned char data_buf[4096];
     struct buddy *buddy;
     START_TEST;
-    buddy = buddy_embed(data_buf, 768 + (sizeof(size_t)*2) + buddy_sizeof(768));
+    buddy = buddy_embed(data_buf, embedded_size(768 + (sizeof(size_t)*2)));
     assert(buddy != NULL);
     assert(buddy_malloc(buddy, 1024) == NULL);
-    buddy = buddy_resize(buddy, 2048 + (sizeof(size_t)*OF(3,9)) + buddy_sizeof(2048));
+    buddy = buddy_resize(buddy, embedded_size(2048));
     assert(buddy != NULL);
     assert(buddy_malloc(buddy, 1024) == data_buf);
     assert(buddy_malloc(buddy, 1024) == data_buf + 1024);
@@ -530,9 +579,9 @@ void test_buddy_resize_embedded_down_within_reserved(void) {
     unsigned char data_buf[4096];
     struct buddy *buddy;
     START_TEST;
-    buddy = buddy_embed(data_buf, 768 + buddy_sizeof(768));
+    buddy = buddy_embed(data_buf, embedded_size(768));
     assert(buddy != NULL);
-    buddy = buddy_resize(buddy, 640 + buddy_sizeof(640));
+    buddy = buddy_resize(buddy, embedded_size(640));
     assert(buddy != NULL);
     assert(buddy_malloc(buddy, 512) == data_buf);
     assert(buddy_malloc(buddy, 64) == data_buf+512);
@@ -540,12 +589,28 @@ void test_buddy_resize_embedded_down_within_reserved(void) {
     assert(buddy_malloc(buddy, 64) == NULL);
 }
 
+void test_buddy_resize_embedded_down_to_arena_size(void) {
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    size_t arena_size;
+    START_TEST;
+    buddy = buddy_embed(data_buf, 1024 + buddy_sizeof(1024));
+    assert(buddy != NULL);
+    arena_size = buddy_arena_size(buddy);
+    /* The new size includes the allocator, so the arena shrinks */
+    buddy = buddy_resize(buddy, arena_size);
+    assert(buddy != NULL);
+    assert(buddy_arena_size(buddy) < arena_size);
+    assert(buddy_malloc(buddy, 512) == data_buf);
+    assert(buddy_malloc(buddy, arena_size - 512) == NULL);
+}
+
 void test_buddy_resize_embedded_down_within_reserved_failure(void) {
     unsigned char data_buf[4096];
     struct buddy *buddy;
     void *r512, *r256;
     START_TEST;
-    buddy = buddy_embed(data_buf, 768 + buddy_sizeof(768));
+    buddy = buddy_embed(data_buf, embedded_size(768));
     assert(buddy != NULL);
     r512 = buddy_malloc(buddy, 512);
     assert(r512 != NULL);
@@ -559,7 +624,7 @@ void test_buddy_resize_embedded_down_at_reserved(void) {
     unsigned char data_buf[4096];
     struct buddy *buddy;
     START_TEST;
-    buddy = buddy_embed(data_buf, 768 + buddy_sizeof(768));
+    buddy = buddy_embed(data_buf, embedded_size(768));
     assert(buddy != NULL);
     assert(buddy_resize(buddy, 512 + buddy_sizeof(512)) != NULL);
 }
@@ -568,7 +633,7 @@ void test_buddy_resize_embedded_down_before_reserved(void) {
     unsigned char data_buf[4096];
     struct buddy *buddy;
     START_TEST;
-    buddy = buddy_embed(data_buf, 768 + buddy_sizeof(768));
+    buddy = buddy_embed(data_buf, embedded_size(768));
     assert(buddy != NULL);
     assert(buddy_resize(buddy, 448 + buddy_sizeof(448)) != NULL);
 }
@@ -616,6 +681,8 @@ void test_buddy_debug(void) {
     buddy_debug(buddy); /* code coverage */
     buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 4096);
     buddy_debug(buddy); /* code coverage */
+    buddy_enable_relative_mode(buddy);
+    buddy_debug(buddy); /* code coverage */
     buddy = buddy_embed(data_buf, 4096);
     buddy_debug(buddy); /* code coverage */
     free(buddy_buf);
@@ -1095,6 +1162,32 @@ void test_buddy_safe_free_invalid_free_07(void) {
     free(buddy_buf_control);
 }
 
+void test_buddy_usable_size(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char buf[8192];
+    unsigned char *data_buf = buf + 2048;
+    struct buddy *buddy;
+    unsigned char *a, *b;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    a = buddy_malloc(buddy, 100);
+    b = buddy_malloc(buddy, 1000);
+    assert(a == data_buf);
+    assert(b == data_buf + 1024);
+    assert(buddy_usable_size(buddy, a) == 128);
+    assert(buddy_usable_size(buddy, b) == 1024);
+    assert(buddy_usable_size(NULL, a) == 0);
+    assert(buddy_usable_size(buddy, NULL) == 0);
+    assert(buddy_usable_size(buddy, data_buf - 1) == 0);
+    assert(buddy_usable_size(buddy, data_buf + 4096) == 0);
+    assert(buddy_usable_size(buddy, a + 1) == 0);
+    assert(buddy_usable_size(buddy, a + 64) == 0);
+    assert(buddy_usable_size(buddy, data_buf + 2048) == 0);
+    buddy_free(buddy, a);
+    assert(buddy_usable_size(buddy, a) == 0);
+    free(buddy_buf);
+}
+
 void test_buddy_demo(void) {
     size_t arena_size = 65536;
     /* You need space for the metadata and for the arena */
@@ -1366,6 +1459,176 @@ void test_buddy_reallocarray_03(void) {
     free(buddy_buf);
 }
 
+void test_buddy_realloc_in_place_invalid(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char buf[8192];
+    unsigned char *data_buf = buf + 2048;
+    struct buddy *buddy;
+    unsigned char *a, *b;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    a = buddy_malloc(buddy, 64);
+    b = buddy_malloc(buddy, 64);
+    assert(buddy_realloc_in_place(NULL, a, 64) == false);
+    assert(buddy_realloc_in_place(buddy, NULL, 64) == false);
+    assert(buddy_realloc_in_place(buddy, a, 0) == false);
+    assert(buddy_realloc_in_place(buddy, a, 8192) == false);
+    assert(buddy_realloc_in_place(buddy, data_buf - 1, 64) == false);
+    assert(buddy_realloc_in_place(buddy, data_buf + 4096, 64) == false);
+    assert(buddy_realloc_in_place(buddy, a + 1, 64) == false);
+    assert(buddy_realloc_in_place(buddy, data_buf + 2048, 64) == false);
+    /* A partially used slot is not an allocation */
+    buddy_free(buddy, a);
+    assert(buddy_realloc_in_place(buddy, a, 64) == false);
+    assert(buddy_usable_size(buddy, b) == 64);
+    free(buddy_buf);
+}
+
+void test_buddy_realloc_in_place_grow(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    unsigned char *a, *b;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    a = buddy_malloc(buddy, 64);
+    assert(a == data_buf);
+    memset(a, 1, 64);
+    assert(buddy_realloc_in_place(buddy, a, 100) == true);
+    assert(buddy_usable_size(buddy, a) == 128);
+    assert(a[63] == 1);
+    assert(buddy_realloc_in_place(buddy, a, 128) == true);
+    b = buddy_malloc(buddy, 64);
+    assert(b == data_buf + 128);
+    /* The adjacent space is in use */
+    assert(buddy_realloc_in_place(buddy, a, 256) == false);
+    assert(buddy_usable_size(buddy, a) == 128);
+    /* The larger slot would start at a lower address */
+    assert(buddy_realloc_in_place(buddy, b, 128) == true);
+    assert(buddy_realloc_in_place(buddy, b, 256) == false);
+    assert(buddy_usable_size(buddy, b) == 128);
+    assert(buddy_safe_free(buddy, b, 128) == BUDDY_SAFE_FREE_SUCCESS);
+    assert(buddy_realloc_in_place(buddy, a, 4096) == true);
+    assert(buddy_is_full(buddy));
+    free(buddy_buf);
+}
+
+void test_buddy_realloc_in_place_shrink(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    unsigned char *a;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    a = buddy_malloc(buddy, 1024);
+    memset(a, 1, 1024);
+    assert(buddy_realloc_in_place(buddy, a, 64) == true);
+    assert(buddy_usable_size(buddy, a) == 64);
+    assert(a[0] == 1);
+    assert(buddy_malloc(buddy, 64) == data_buf + 64);
+    assert(buddy_malloc(buddy, 2048) == data_buf + 2048);
+    free(buddy_buf);
+}
+
+void test_buddy_malloc_sg_invalid(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    struct buddy_segment segments[4];
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    assert(buddy_malloc_sg(NULL, 64, segments, 4) == 0);
+    assert(buddy_malloc_sg(buddy, 64, NULL, 4) == 0);
+    assert(buddy_malloc_sg(buddy, 64, segments, 0) == 0);
+    assert(buddy_malloc_sg(buddy, 0, segments, 4) == 0);
+    assert(buddy_malloc_sg(buddy, 8192, segments, 4) == 0);
+    buddy_free_sg(NULL, segments, 4);
+    buddy_free_sg(buddy, NULL, 4);
+    assert(buddy_is_empty(buddy));
+#ifndef _MSC_VER
+    /* Segments can be passed to readv and writev */
+    assert(sizeof(struct buddy_segment) == sizeof(struct iovec));
+    assert(offsetof(struct buddy_segment, base) == offsetof(struct iovec, iov_base));
+    assert(offsetof(struct buddy_segment, length) == offsetof(struct iovec, iov_len));
+#endif
+    free(buddy_buf);
+}
+
+void test_buddy_malloc_sg_contiguous(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    struct buddy_segment segments[4];
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    assert(buddy_malloc_sg(buddy, 3000, segments, 4) == 1);
+    assert(segments[0].base == data_buf);
+    assert(segments[0].length == 3000);
+    assert(buddy_is_full(buddy));
+    buddy_free_sg(buddy, segments, 1);
+    assert(buddy_is_empty(buddy));
+    free(buddy_buf);
+}
+
+void test_buddy_malloc_sg_fragmented(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    struct buddy_segment segments[4];
+    struct buddy *buddy;
+    unsigned char *slots[4];
+    size_t i;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    for (i = 0; i < 4; i++) {
+        slots[i] = buddy_malloc(buddy, 1024);
+    }
+    buddy_free(buddy, slots[0]);
+    buddy_free(buddy, slots[2]);
+    buddy_free(buddy, buddy_malloc(buddy, 64));
+    /* No contiguous 2048 bytes are free */
+    assert(buddy_malloc(buddy, 2048) == NULL);
+    assert(buddy_malloc_sg(buddy, 1500, segments, 4) == 2);
+    assert(segments[0].base == data_buf);
+    assert(segments[0].length == 1024);
+    assert(segments[1].base == data_buf + 2048);
+    assert(segments[1].length == 476);
+    assert(buddy_usable_size(buddy, segments[1].base) == 512);
+    buddy_free_sg(buddy, segments, 2);
+    assert(buddy_malloc_sg(buddy, 2048, segments, 4) == 2);
+    assert(buddy_is_full(buddy));
+    buddy_free_sg(buddy, segments, 2);
+    assert(buddy_arena_free_size(buddy) == 2048);
+    free(buddy_buf);
+}
+
+void test_buddy_malloc_sg_failure(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    struct buddy_segment segments[8], more[64];
+    struct buddy *buddy;
+    size_t i;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    /* Every other 64 byte slot is free */
+    for (i = 0; i < 64; i++) {
+        assert(buddy_malloc(buddy, 64) == data_buf + (i * 64));
+    }
+    for (i = 0; i < 64; i += 2) {
+        buddy_free(buddy, data_buf + (i * 64));
+    }
+    /* Too many segments are needed */
+    assert(buddy_malloc_sg(buddy, 1024, segments, 8) == 0);
+    assert(buddy_arena_free_size(buddy) == 2048);
+    assert(buddy_malloc_sg(buddy, 512, segments, 8) == 8);
+    assert(buddy_arena_free_size(buddy) == 1536);
+    /* Not enough free memory */
+    assert(buddy_malloc_sg(buddy, 2048, more, 64) == 0);
+    assert(buddy_arena_free_size(buddy) == 1536);
+    buddy_free_sg(buddy, segments, 8);
+    assert(buddy_arena_free_size(buddy) == 2048);
+    free(buddy_buf);
+}
+
 void test_buddy_embedded_not_enough_memory(void) {
     unsigned char buf[4];
     START_TEST;
@@ -1434,6 +1697,137 @@ void test_buddy_embed_at(void) {
     assert(buddy_malloc(buddy, 2048) == buf2);
 }
 
+void test_buddy_clone(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char *clone_buf = malloc(buddy_sizeof(4096));
+    unsigned char *data_buf = malloc(4096);
+    unsigned char *clone_data = malloc(4096);
+    struct buddy *buddy, *clone;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    assert(buddy_malloc(buddy, 1024) == data_buf);
+    strcpy((char *) data_buf, "kept");
+
+    /* Copy the arena and the allocator */
+    memcpy(clone_data, data_buf, 4096);
+    clone = buddy_clone(clone_buf, buddy, clone_data);
+    assert(clone == (struct buddy *) clone_buf);
+    assert(strcmp((char *) clone_data, "kept") == 0);
+    assert(buddy_malloc(clone, 2048) == clone_data + 2048);
+    buddy_free(clone, clone_data);
+    assert(buddy_malloc(clone, 1024) == clone_data);
+
+    /* The source is not affected */
+    assert(buddy_malloc(buddy, 2048) == data_buf + 2048);
+    assert(buddy_malloc(buddy, 1024) == data_buf + 1024);
+    assert(buddy_malloc(buddy, 1024) == NULL);
+    free(clone_data);
+    free(data_buf);
+    free(clone_buf);
+    free(buddy_buf);
+}
+
+void test_buddy_clone_embedded(void) {
+    unsigned char *buf = malloc(4096);
+    unsigned char *clone_buf = malloc(4096);
+    struct buddy *buddy, *clone;
+    unsigned char *a, *b;
+    START_TEST;
+    buddy = buddy_embed(buf, 4096);
+    a = buddy_malloc(buddy, 1024);
+    assert(a != NULL);
+
+    /* The allocator is placed within the new arena */
+    clone = buddy_clone(NULL, buddy, clone_buf);
+    assert(clone == buddy_get_embed_at(clone_buf, 4096));
+    b = buddy_malloc(clone, 1024);
+    assert((b != NULL) && (b - clone_buf != a - buf));
+    assert(buddy_safe_free(clone, clone_buf + (a - buf), 1024) == BUDDY_SAFE_FREE_SUCCESS);
+
+    /* The source is not affected */
+    assert(buddy_malloc(buddy, 1024) == buf + (b - clone_buf));
+    assert(buddy_safe_free(buddy, a, 1024) == BUDDY_SAFE_FREE_SUCCESS);
+    free(clone_buf);
+    free(buf);
+}
+
+void test_buddy_clone_invalid(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char *clone_buf = malloc(buddy_sizeof(4096) + 1);
+    unsigned char *data_buf = malloc(4096);
+    unsigned char *clone_data = malloc(4096 + 1);
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    assert(buddy_clone(clone_buf, NULL, clone_data) == NULL);
+    assert(buddy_clone(clone_buf, buddy, NULL) == NULL);
+    assert(buddy_clone(NULL, buddy, clone_data) == NULL);
+    assert(buddy_clone(clone_data, buddy, clone_data) == NULL);
+    assert(buddy_clone(clone_buf + 1, buddy, clone_data) == NULL);
+    assert(buddy_clone(clone_buf, buddy, clone_data + 1) == NULL);
+    free(clone_data);
+    free(data_buf);
+    free(clone_buf);
+    free(buddy_buf);
+}
+
+void test_buddy_relative_mode(void) {
+    /* Keep the arena aligned */
+    size_t buddy_size = (buddy_sizeof(4096) + 63) / 64 * 64;
+    unsigned char *region = malloc(buddy_size + 4096);
+    unsigned char *moved = malloc(buddy_size + 4096);
+    struct buddy *buddy;
+    unsigned char *a;
+    START_TEST;
+    /* The allocator and its arena in the same mapping */
+    buddy = buddy_init(region, region + buddy_size, 4096);
+    buddy_enable_relative_mode(NULL);
+    buddy_enable_relative_mode(buddy);
+    a = buddy_malloc(buddy, 1024);
+    assert(a == region + buddy_size);
+
+    /* Map it elsewhere */
+    memcpy(moved, region, buddy_size + 4096);
+    buddy = (struct buddy *) moved;
+    assert(buddy_malloc(buddy, 1024) == moved + buddy_size + 1024);
+    buddy_free(buddy, moved + buddy_size);
+    assert(buddy_malloc(buddy, 2048) == moved + buddy_size + 2048);
+
+    /* The arena can be resized in place */
+    assert(buddy_resize(buddy, 2048) == NULL);
+    buddy_free(buddy, moved + buddy_size + 2048);
+    assert(buddy_resize(buddy, 2048) == buddy);
+    assert(buddy_arena_size(buddy) == 2048);
+    free(moved);
+    free(region);
+}
+
+void test_buddy_relative_mode_clone(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char *clone_buf = malloc(buddy_sizeof(4096));
+    unsigned char *data_buf = malloc(4096);
+    unsigned char *clone_data = malloc(4096);
+    unsigned char embedded[4096];
+    struct buddy *buddy, *clone;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    buddy_enable_relative_mode(buddy);
+    assert(buddy_malloc(buddy, 1024) == data_buf);
+    clone = buddy_clone(clone_buf, buddy, clone_data);
+    assert(clone == (struct buddy *) clone_buf);
+    assert(buddy_malloc(clone, 1024) == clone_data + 1024);
+
+    /* Embedded allocators are relative already */
+    buddy = buddy_embed(embedded, 4096);
+    buddy_enable_relative_mode(buddy);
+    assert(buddy == buddy_get_embed_at(embedded, 4096));
+    assert(buddy_main(buddy) == embedded);
+    free(clone_data);
+    free(data_buf);
+    free(clone_buf);
+    free(buddy_buf);
+}
+
 void test_buddy_mixed_use_01(void) {
     unsigned char *buddy_buf = malloc(buddy_sizeof(512));
     unsigned char data_buf[512];
@@ -1822,6 +2216,173 @@ void test_buddy_fragmentation(void) {
     free(data_buf);
 }
 
+void test_buddy_recover(void) {
+    size_t buddy_size = buddy_sizeof_alignment(4096, 64);
+    unsigned char *buddy_buf = malloc(buddy_size);
+    unsigned char *saved_buf = malloc(buddy_size);
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    struct buddy_tree *t;
+    struct buddy_tree_pos pos;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    t = buddy_tree(buddy);
+    /* Experimental state that is stored after the tree is not restored as it was */
+    buddy_size = (size_t) ((unsigned char *) t - buddy_buf) + buddy_tree_sizeof(buddy_tree_order(t));
+    assert(buddy_malloc(buddy, 64) == data_buf);
+    assert(buddy_malloc(buddy, 1024) == data_buf + 1024);
+    assert(buddy_malloc(buddy, 128) == data_buf + 128);
+    memcpy(saved_buf, buddy_buf, buddy_size);
+
+    /* Nothing to do for a consistent tree */
+    buddy_recover(buddy);
+    buddy_recover(NULL);
+    assert(memcmp(saved_buf, buddy_buf, buddy_size) == 0);
+
+    /* Stale inner nodes are recomputed from their children */
+    write_to_internal_position(t, buddy_tree_internal_position_tree(t, buddy_tree_root()), 0);
+    pos = buddy_tree_left_child(buddy_tree_left_child(buddy_tree_root()));
+    write_to_internal_position(t, buddy_tree_internal_position_tree(t, pos), 5);
+    /* A partially-used node without used children is free */
+    pos = buddy_tree_right_child(buddy_tree_right_child(buddy_tree_root()));
+    write_to_internal_position(t, buddy_tree_internal_position_tree(t, pos), 2);
+    buddy_recover(buddy);
+    assert(buddy_tree_check_invariant(t, buddy_tree_root()) == 0);
+    assert(memcmp(saved_buf, buddy_buf, buddy_size) == 0);
+
+    /* A slot that was marked without updating its parents is kept */
+    pos = deepest_position_for_offset(buddy, 4032);
+    write_to_internal_position(t, buddy_tree_internal_position_tree(t, pos), 1);
+    buddy_recover(buddy);
+    assert(buddy_tree_check_invariant(t, buddy_tree_root()) == 0);
+    assert(buddy_arena_free_size(buddy) == 4096 - 64 - 1024 - 128 - 64);
+    buddy_free(buddy, data_buf + 4032);
+    assert(memcmp(saved_buf, buddy_buf, buddy_size) == 0);
+
+    free(saved_buf);
+    free(buddy_buf);
+}
+
+void test_buddy_serialize(void) {
+    size_t memory_size = (1 << 20) - (3 * 4096);
+    unsigned char *src_buf = malloc(buddy_sizeof_alignment(memory_size, 64));
+    unsigned char *dst_buf = malloc(buddy_sizeof_alignment(memory_size, 64));
+    unsigned char *src_data = malloc(memory_size);
+    unsigned char *dst_data = malloc(memory_size);
+    unsigned char snapshot[64];
+    struct buddy *src, *dst;
+    unsigned char *a, *b;
+    size_t length;
+    START_TEST;
+    src = buddy_init_alignment(src_buf, src_data, memory_size, 64);
+    dst = buddy_init_alignment(dst_buf, dst_data, memory_size, 64);
+    assert(buddy_malloc(dst, 4096) != NULL);
+
+    a = buddy_malloc(src, 64);
+    assert(buddy_malloc(src, 1000) != NULL);
+    b = buddy_malloc(src, 100000);
+    assert(buddy_malloc(src, 4096) != NULL);
+    buddy_reserve_range(src, src_data + 500000, 300);
+
+    /* The snapshot size does not depend on the arena size */
+    length = buddy_serialize(src, NULL, 0);
+    assert(length <= sizeof(snapshot));
+    assert(length < buddy_sizeof_alignment(memory_size, 64) / 100);
+    assert(buddy_serialize(src, snapshot, sizeof(snapshot)) == length);
+
+    assert(buddy_deserialize(dst, snapshot, length));
+    assert(memcmp(buddy_tree(src), buddy_tree(dst), buddy_tree_sizeof(buddy_tree_order(buddy_tree(src)))) == 0);
+    assert(buddy_arena_free_size(dst) == buddy_arena_free_size(src));
+
+    /* The same slots are allocated at the other address */
+    buddy_free(dst, dst_data + (a - src_data));
+    buddy_free(dst, dst_data + (b - src_data));
+    assert(buddy_arena_free_size(dst) == buddy_arena_free_size(src) + 64 + 131072);
+
+    /* An empty allocator */
+    buddy_free(src, a);
+    length = buddy_serialize(buddy_init_alignment(src_buf, src_data, memory_size, 64), snapshot, sizeof(snapshot));
+    assert(buddy_deserialize(dst, snapshot, length));
+    assert(buddy_is_empty(dst));
+
+    assert(buddy_serialize(NULL, snapshot, sizeof(snapshot)) == 0);
+    free(dst_data);
+    free(src_data);
+    free(dst_buf);
+    free(src_buf);
+}
+
+void test_buddy_serialize_capacity(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    unsigned char snapshot[16];
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    assert(buddy_malloc(buddy, 64) == data_buf);
+    assert(buddy_malloc(buddy, 64) == data_buf + 64);
+    /* memory size, alignment, two slots and the terminator */
+    assert(buddy_serialize(buddy, NULL, 0) == 2 + 1 + 4 + 1);
+    memset(snapshot, 0xFF, sizeof(snapshot));
+    assert(buddy_serialize(buddy, snapshot, 4) == 8);
+    assert(snapshot[4] == 0xFF);
+    free(buddy_buf);
+}
+
+void test_buddy_deserialize_invalid(void) {
+    size_t buddy_size = buddy_sizeof_alignment(4096, 64);
+    unsigned char *buddy_buf = malloc(buddy_size);
+    unsigned char *saved_buf = malloc(buddy_size);
+    unsigned char *other_buf = malloc(buddy_sizeof_alignment(4096, 128));
+    unsigned char data_buf[4096];
+    unsigned char snapshot[16];
+    /* memory size 4096 and alignment 64 */
+    unsigned char too_deep[] = { 0x80, 0x20, 0x40, 8, 0, 0 };
+    unsigned char past_arena[] = { 0x80, 0x20, 0x40, 7, 65, 0 };
+    unsigned char misaligned[] = { 0x80, 0x20, 0x40, 6, 1, 0 };
+    unsigned char overflow[] = { 0x80, 0x20, 0x40, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F };
+    unsigned char too_long[] = { 0x80, 0x20, 0x40, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x81, 0x01 };
+    unsigned char truncated[] = { 0x80, 0x20, 0x40, 7 };
+    /* memory size 3072, two slots of 2048 */
+    unsigned char past_end[] = { 0x80, 0x18, 0x40, 2, 0, 2, 0, 0 };
+    unsigned char within[] = { 0x80, 0x18, 0x40, 2, 0, 0 };
+    struct buddy *buddy;
+    size_t length;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    assert(buddy_malloc(buddy, 64) == data_buf);
+    length = buddy_serialize(buddy, snapshot, sizeof(snapshot));
+    memcpy(saved_buf, buddy_buf, buddy_size);
+
+    assert(! buddy_deserialize(NULL, snapshot, length));
+    assert(! buddy_deserialize(buddy, NULL, length));
+    assert(! buddy_deserialize(buddy, snapshot, 0));
+    assert(! buddy_deserialize(buddy, snapshot, 1));
+    assert(! buddy_deserialize(buddy, snapshot, 2));
+    assert(! buddy_deserialize(buddy, snapshot, length - 1));
+    assert(! buddy_deserialize(buddy, too_deep, sizeof(too_deep)));
+    assert(! buddy_deserialize(buddy, past_arena, sizeof(past_arena)));
+    assert(! buddy_deserialize(buddy, misaligned, sizeof(misaligned)));
+    assert(! buddy_deserialize(buddy, overflow, sizeof(overflow)));
+    assert(! buddy_deserialize(buddy, too_long, sizeof(too_long)));
+    assert(! buddy_deserialize(buddy, truncated, sizeof(truncated)));
+    assert(memcmp(saved_buf, buddy_buf, buddy_size) == 0);
+
+    /* The allocator must match the serialized one */
+    assert(! buddy_deserialize(buddy_init_alignment(other_buf, data_buf, 4096, 128), snapshot, length));
+    assert(! buddy_deserialize(buddy_init_alignment(other_buf, data_buf, 2048, 64), snapshot, length));
+
+    /* A slot that ends past a non-power-of-two arena */
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 3072, 64);
+    assert(! buddy_deserialize(buddy, past_end, sizeof(past_end)));
+    assert(buddy_deserialize(buddy, within, sizeof(within)));
+    assert(buddy_arena_free_size(buddy) == 1024);
+
+    free(other_buf);
+    free(saved_buf);
+    free(buddy_buf);
+}
+
 void test_buddy_is_empty(void) {
     size_t buddy_size = 1024;
     unsigned char *buddy_buf = malloc(buddy_sizeof(buddy_size));
@@ -1889,34 +2450,838 @@ void test_buddy_invalid_slot_alignment(void) {
 struct buddy_change_tracker_context {
     size_t total_length;
     size_t total_calls;
+    size_t range_count;
+    struct buddy_change_range ranges[BUDDY_CHANGE_TRACKING_RANGES];
 };
 
-void buddy_change_tracker_cb(void* context, unsigned char* addr, size_t length) {
+void buddy_change_tracker_cb(void* context, struct buddy_change_range* ranges, size_t count) {
     struct buddy_change_tracker_context *tracker_context = (struct buddy_change_tracker_context *) context;
-    tracker_context->total_length += length;
+    assert(count > 0);
+    assert(count <= BUDDY_CHANGE_TRACKING_RANGES);
+    for (size_t i = 0; i < count; i++) {
+        assert(ranges[i].length > 0);
+        /* Sorted and disjoint */
+        assert((i == 0) || (ranges[i].addr > (ranges[i-1].addr + ranges[i-1].length)));
+        tracker_context->total_length += ranges[i].length;
+    }
+    memcpy(tracker_context->ranges, ranges, count * sizeof(*ranges));
+    tracker_context->range_count = count;
     tracker_context->total_calls++;
 }
 
-void test_buddy_change_tracking() {
+/* Returns the size of the allocator state up to the end of the tree */
+size_t buddy_change_tracker_metadata_size(struct buddy *buddy) {
+    struct buddy_tree *t = buddy_tree(buddy);
+    return (size_t) ((unsigned char *) t - (unsigned char *) buddy) + buddy_tree_sizeof(buddy_tree_order(t));
+}
+
+/* Checks that every byte of the tree that differs from the snapshot was reported */
+void buddy_change_tracker_verify(struct buddy_change_tracker_context *context,
+        unsigned char *snapshot, struct buddy *buddy) {
+    unsigned char *metadata = (unsigned char *) buddy;
+    size_t length = buddy_change_tracker_metadata_size(buddy);
+    for (size_t i = 0; i < length; i++) {
+        size_t covered = 0;
+        if (snapshot[i] == metadata[i]) {
+            continue;
+        }
+        for (size_t j = 0; j < context->range_count; j++) {
+            if ((metadata + i >= context->ranges[j].addr)
+                    && (metadata + i < context->ranges[j].addr + context->ranges[j].length)) {
+                covered = 1;
+            }
+        }
+        assert(covered);
+    }
+    memcpy(snapshot, metadata, length);
+}
+
+void test_buddy_change_tracking(void) {
     struct buddy_change_tracker_context context = {0};
     unsigned char arena[4096] = {0};
+    unsigned char snapshot[4096];
     struct buddy *buddy = buddy_embed(arena, 4096);
-    void *slot;
+    void *slots[4];
     START_TEST;
     buddy_enable_change_tracking(buddy, &context, buddy_change_tracker_cb);
     assert(context.total_length == 0);
     assert(context.total_calls == 0);
-    slot = buddy_malloc(buddy, 512);
-    assert(context.total_length == 2);
+    memcpy(snapshot, buddy, buddy_change_tracker_metadata_size(buddy));
+
+    /* One call per operation */
+    slots[0] = buddy_malloc(buddy, 512);
+    assert(context.total_calls == 1);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    /* The whole path up to the root is a few bytes of the bitset */
+    assert(context.total_length < 8);
+    buddy_free(buddy, slots[0]);
     assert(context.total_calls == 2);
-    buddy_free(buddy, slot);
-    assert(context.total_length == 4);
-    assert(context.total_calls == 4);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+
+    slots[0] = buddy_malloc(buddy, 64);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    slots[1] = buddy_calloc(buddy, 1, 1024);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    slots[2] = buddy_malloc(buddy, 128);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    slots[0] = buddy_realloc(buddy, slots[0], 256, false);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    assert(buddy_safe_free(buddy, slots[2], 128) == BUDDY_SAFE_FREE_SUCCESS);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    slots[3] = buddy_malloc(buddy, 64);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    buddy_unsafe_release_range(buddy, slots[3], 64);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    buddy_reserve_range(buddy, slots[3], 64);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    buddy_free(buddy, slots[0]);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    buddy_free(buddy, slots[1]);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+    assert(context.total_calls == 12);
+}
+
+void test_buddy_change_tracking_merge(void) {
+    struct buddy_change_tracker_context context = {0};
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(1 << 20, 64));
+    unsigned char *data_buf = malloc(1 << 20);
+    unsigned char *snapshot = malloc(buddy_sizeof_alignment(1 << 20, 64));
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 1 << 20, 64);
+    buddy_enable_change_tracking(buddy, &context, buddy_change_tracker_cb);
+    memcpy(snapshot, buddy, buddy_change_tracker_metadata_size(buddy));
+
+    /* The first slot in the right half changes more rows than there are ranges */
+    buddy_reserve_range(buddy, data_buf + (1 << 19), 64);
+    assert(context.total_calls == 1);
+    assert(context.range_count == BUDDY_CHANGE_TRACKING_RANGES);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+
+    /* Moving it to the left half changes two paths at once */
+    assert(buddy_realloc(buddy, data_buf + (1 << 19), 64, true) != NULL);
+    assert(context.total_calls == 2);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+
+    /* Resizing is not tracked */
+    assert(buddy_resize(buddy, 1 << 19) == buddy);
+    assert(context.total_calls == 2);
+    memcpy(snapshot, buddy, buddy_change_tracker_metadata_size(buddy));
+    assert(buddy_malloc(buddy, 64) != NULL);
+    assert(context.total_calls == 3);
+    buddy_change_tracker_verify(&context, snapshot, buddy);
+
+    free(snapshot);
+    free(data_buf);
+    free(buddy_buf);
 }
 #else
 #define test_buddy_change_tracking()
+#define test_buddy_change_tracking_merge()
 #endif /* BUDDY_EXPERIMENTAL_CHANGE_TRACKING */
 
+#ifdef BUDDY_EXPERIMENTAL_DEFERRED_FREE
+void test_buddy_deferred_free_reuse(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    void *a, *b;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    buddy_enable_deferred_free(buddy);
+    a = buddy_malloc(buddy, 64);
+    b = buddy_malloc(buddy, 64);
+    buddy_free(buddy, a);
+    buddy_free(buddy, b);
+    /* Pending slots remain allocated in the tree */
+    assert(buddy_tree_status(buddy_tree(buddy), buddy_tree_root()) != 0);
+    /* The most recently freed slot is reused first */
+    assert(buddy_malloc(buddy, 64) == b);
+    assert(buddy_malloc(buddy, 64) == a);
+    /* Other sizes are served from the tree */
+    assert(buddy_malloc(buddy, 128) == data_buf + 128);
+    free(buddy_buf);
+}
+
+void test_buddy_deferred_free_depths(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    void *a, *b, *c;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    buddy_enable_deferred_free(buddy);
+    a = buddy_malloc(buddy, 64);
+    b = buddy_malloc(buddy, 128);
+    c = buddy_malloc(buddy, 64);
+    buddy_free(buddy, a);
+    buddy_free(buddy, b);
+    buddy_free(buddy, c);
+    /* Each depth keeps its own LIFO order */
+    assert(buddy_malloc(buddy, 128) == b);
+    assert(buddy_malloc(buddy, 64) == c);
+    buddy_free(buddy, b);
+    assert(buddy_malloc(buddy, 64) == a);
+    assert(buddy_malloc(buddy, 128) == b);
+    assert(buddy_tree_check_invariant(buddy_tree(buddy), buddy_tree_root()) == 0);
+    free(buddy_buf);
+}
+
+void test_buddy_deferred_free_double_free(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    void *a, *b;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    buddy_enable_deferred_free(buddy);
+    a = buddy_malloc(buddy, 64);
+    buddy_free(buddy, a);
+    buddy_free(buddy, a);
+    assert(buddy_malloc(buddy, 64) == a);
+    b = buddy_malloc(buddy, 64);
+    assert(b != NULL);
+    assert(b != a);
+    /* Freeing the start of a partially-used span is ignored */
+    buddy_free(buddy, a);
+    assert(! buddy_is_empty(buddy));
+    buddy_free(buddy, a);
+    assert(buddy_malloc(buddy, 64) == a);
+    assert(buddy_tree_check_invariant(buddy_tree(buddy), buddy_tree_root()) == 0);
+    free(buddy_buf);
+}
+
+void test_buddy_deferred_free_batch(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char data_buf[4096];
+    void *slots[64];
+    struct buddy *buddy;
+    size_t count = 64;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    buddy_enable_deferred_free(buddy);
+    for (size_t i = 0; i < count; i++) {
+        slots[i] = buddy_malloc(buddy, 64);
+        assert(slots[i] != NULL);
+    }
+    assert(buddy_is_full(buddy));
+    /* Frees beyond the buffer capacity release the pending slots in a batch */
+    for (size_t i = 0; i < count; i++) {
+        buddy_free(buddy, slots[i]);
+    }
+    assert(buddy_tree_check_invariant(buddy_tree(buddy), buddy_tree_root()) == 0);
+    /* A miss releases the rest */
+    assert(buddy_malloc(buddy, 4096) == data_buf);
+    assert(buddy_tree_check_invariant(buddy_tree(buddy), buddy_tree_root()) == 0);
+    free(buddy_buf);
+}
+
+void test_buddy_deferred_free_queries(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    void *a;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    buddy_enable_deferred_free(buddy);
+    a = buddy_malloc(buddy, 2048);
+    buddy_free(buddy, a);
+    assert(buddy_is_empty(buddy));
+    assert(buddy_arena_free_size(buddy) == 4096);
+    a = buddy_malloc(buddy, 4096);
+    buddy_free(buddy, a);
+    assert(! buddy_is_full(buddy));
+    free(buddy_buf);
+}
+#else
+#define test_buddy_deferred_free_reuse()
+#define test_buddy_deferred_free_depths()
+#define test_buddy_deferred_free_double_free()
+#define test_buddy_deferred_free_batch()
+#define test_buddy_deferred_free_queries()
+#endif /* BUDDY_EXPERIMENTAL_DEFERRED_FREE */
+
+#ifdef BUDDY_EXPERIMENTAL_ZERO_TRACKING
+void test_buddy_zero_tracking_calloc(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    unsigned char *a;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    memset(data_buf, 0xAA, 4096);
+    /* Only the second block lies entirely within the range */
+    buddy_mark_zeroed(buddy, data_buf + 1, 127);
+    a = buddy_calloc(buddy, 1, 256);
+    assert(a == data_buf);
+    assert(a[0] == 0);
+    assert(a[63] == 0);
+    assert(a[64] == 0xAA); /* known zero, left as is */
+    assert(a[127] == 0xAA);
+    assert(a[128] == 0);
+    assert(a[255] == 0);
+    assert(data_buf[256] == 0xAA);
+    /* Allocation forgets the zero state */
+    buddy_free(buddy, a);
+    a = buddy_calloc(buddy, 1, 256);
+    assert(a[64] == 0);
+    free(buddy_buf);
+}
+
+void test_buddy_zero_tracking_handout(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    unsigned char *a;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    memset(data_buf, 0xAA, 4096);
+    buddy_mark_zeroed(buddy, data_buf, 4096);
+    /* malloc, realloc and reservation all hand out memory */
+    a = buddy_malloc(buddy, 64);
+    a = buddy_realloc(buddy, a, 128, false);
+    assert(a == data_buf);
+    buddy_reserve_range(buddy, data_buf + 128, 64);
+    buddy_unsafe_release_range(buddy, data_buf + 128, 64);
+    buddy_free(buddy, a);
+    a = buddy_calloc(buddy, 1, 256);
+    assert(a == data_buf);
+    assert(a[0] == 0);
+    assert(a[127] == 0);
+    assert(a[128] == 0);
+    assert(a[191] == 0);
+    assert(a[192] == 0xAA);
+    free(buddy_buf);
+}
+
+void test_buddy_zero_tracking_mark_invalid(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(4096));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    unsigned char *a;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 4096);
+    memset(data_buf, 0xAA, 4096);
+    buddy_mark_zeroed(NULL, data_buf, 4096);
+    buddy_mark_zeroed(buddy, NULL, 4096);
+    buddy_mark_zeroed(buddy, data_buf - 1, 4096);
+    buddy_mark_zeroed(buddy, data_buf + 4096, 4096);
+    buddy_mark_zeroed(buddy, data_buf + 1, 64);
+    /* Ranges past the arena end are trimmed */
+    buddy_mark_zeroed(buddy, data_buf + 4032, 4096);
+    a = buddy_calloc(buddy, 1, 4096);
+    assert(a == data_buf);
+    assert(a[0] == 0);
+    assert(a[127] == 0);
+    assert(a[4031] == 0);
+    assert(a[4032] == 0xAA);
+    free(buddy_buf);
+}
+
+void test_buddy_zero_tracking_resize(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof(8192));
+    unsigned char data_buf[8192];
+    struct buddy *buddy;
+    unsigned char *a, *b;
+    START_TEST;
+    buddy = buddy_init(buddy_buf, data_buf, 3072);
+    memset(data_buf, 0xAA, 8192);
+    buddy_mark_zeroed(buddy, data_buf, 3072);
+    /* Growing keeps the known-zero blocks, the new memory is dirty */
+    assert(buddy_resize(buddy, 8192) == buddy);
+    a = buddy_calloc(buddy, 1, 4096);
+    assert(a == data_buf);
+    assert(a[3071] == 0xAA);
+    assert(a[3072] == 0);
+    assert(a[4095] == 0);
+    b = buddy_calloc(buddy, 1, 4096);
+    assert(b == data_buf + 4096);
+    assert(b[0] == 0);
+    buddy_free(buddy, a);
+    buddy_free(buddy, b);
+    /* Shrinking keeps them too */
+    memset(data_buf, 0xAA, 8192);
+    buddy_mark_zeroed(buddy, data_buf, 8192);
+    assert(buddy_resize(buddy, 4096) == buddy);
+    a = buddy_calloc(buddy, 1, 4096);
+    assert(a == data_buf);
+    assert(a[0] == 0xAA);
+    assert(a[4095] == 0xAA);
+    free(buddy_buf);
+}
+#else
+#define test_buddy_zero_tracking_calloc()
+#define test_buddy_zero_tracking_handout()
+#define test_buddy_zero_tracking_mark_invalid()
+#define test_buddy_zero_tracking_resize()
+#endif /* BUDDY_EXPERIMENTAL_ZERO_TRACKING */
+
+#ifdef BUDDY_EXPERIMENTAL_TWO_PHASE
+void test_buddy_two_phase_recover(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    void *a, *b;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    assert(buddy_reserve(NULL, 64) == NULL);
+    assert(buddy_reserve(buddy, 8192) == NULL);
+    a = buddy_reserve(buddy, 64);
+    b = buddy_reserve(buddy, 1024);
+    assert(a != NULL);
+    assert(b != NULL);
+    buddy_publish(buddy, b);
+    buddy_publish(buddy, b);
+    buddy_publish(NULL, a);
+    buddy_publish(buddy, NULL);
+    buddy_publish(buddy, data_buf + 32);
+    /* The unpublished block is reclaimed, the published one stays */
+    buddy_recover(buddy);
+    assert(buddy_arena_free_size(buddy) == 4096 - 1024);
+    buddy_free(buddy, b);
+    assert(buddy_is_empty(buddy));
+    free(buddy_buf);
+}
+
+void test_buddy_two_phase_free(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    void *a;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    /* A freed tentative block is forgotten and its slot can be reused */
+    a = buddy_reserve(buddy, 64);
+    buddy_free(buddy, a);
+    assert(buddy_malloc(buddy, 64) == a);
+    buddy_recover(buddy);
+    assert(! buddy_is_empty(buddy));
+    buddy_free(buddy, a);
+    a = buddy_reserve(buddy, 64);
+    assert(buddy_safe_free(buddy, a, 64) == BUDDY_SAFE_FREE_SUCCESS);
+    assert(buddy_malloc(buddy, 64) == a);
+    buddy_recover(buddy);
+    assert(! buddy_is_empty(buddy));
+    free(buddy_buf);
+}
+
+void test_buddy_two_phase_full(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(4096, 64));
+    unsigned char data_buf[4096];
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    for (size_t i = 0; i < BUDDY_TENTATIVE_SLOTS; i++) {
+        assert(buddy_reserve(buddy, 64) != NULL);
+    }
+    assert(buddy_reserve(buddy, 64) == NULL);
+    buddy_recover(buddy);
+    assert(buddy_is_empty(buddy));
+    free(buddy_buf);
+}
+
+void test_buddy_two_phase_move(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(8192, 64));
+    unsigned char data_buf[8192];
+    struct buddy *buddy;
+    void *a, *b;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 4096, 64);
+    /* Realloc and resize keep tracking the block */
+    a = buddy_reserve(buddy, 64);
+    b = buddy_malloc(buddy, 64);
+    a = buddy_realloc(buddy, a, 128, false);
+    assert(a == data_buf + 128);
+    assert(buddy_resize(buddy, 8192) == buddy);
+    buddy_recover(buddy);
+    assert(buddy_arena_free_size(buddy) == 8192 - 64);
+    a = buddy_reserve(buddy, 256);
+    assert(buddy_resize(buddy, 2048) == buddy);
+    buddy_recover(buddy);
+    assert(buddy_arena_free_size(buddy) == 2048 - 64);
+    buddy_free(buddy, b);
+    assert(buddy_is_empty(buddy));
+    /* .. as does growing it in place */
+    a = buddy_reserve(buddy, 64);
+    assert(buddy_realloc_in_place(buddy, a, 128));
+    assert(! buddy_is_empty(buddy));
+    buddy_recover(buddy);
+    assert(buddy_is_empty(buddy));
+    free(buddy_buf);
+}
+#else
+#define test_buddy_two_phase_recover()
+#define test_buddy_two_phase_free()
+#define test_buddy_two_phase_full()
+#define test_buddy_two_phase_move()
+#endif /* BUDDY_EXPERIMENTAL_TWO_PHASE */
+
+#ifdef BUDDY_EXPERIMENTAL_DIRTY_PAGES
+struct buddy_dirty_runs {
+    size_t count;
+    unsigned char *addr[16];
+    size_t length[16];
+    unsigned int stop;
+};
+
+void *buddy_dirty_runs_cb(void *ctx, void *addr, size_t length) {
+    struct buddy_dirty_runs *runs = (struct buddy_dirty_runs *) ctx;
+    runs->addr[runs->count] = (unsigned char *) addr;
+    runs->length[runs->count] = length;
+    runs->count++;
+    return runs->stop ? ctx : NULL;
+}
+
+void test_buddy_dirty_pages_walk(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(65536, 64));
+    unsigned char *data_buf = malloc(65536);
+    struct buddy_dirty_runs runs = {0};
+    struct buddy *buddy;
+    unsigned char *a, *c;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 65536, 64);
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 0);
+
+    a = buddy_malloc(buddy, 100);
+    assert(a == data_buf);
+    assert(buddy_malloc(buddy, 8192) == data_buf + 8192);
+    c = buddy_malloc(buddy, 4096);
+    assert(c == data_buf + 4096);
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 1);
+    assert((runs.addr[0] == data_buf) && (runs.length[0] == 16384));
+
+    /* Freed pages are skipped */
+    buddy_free(buddy, c);
+    runs.count = 0;
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 2);
+    assert((runs.addr[0] == data_buf) && (runs.length[0] == 4096));
+    assert((runs.addr[1] == data_buf + 8192) && (runs.length[1] == 8192));
+
+    /* The iteration can be stopped */
+    runs.count = 0;
+    runs.stop = 1;
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == &runs);
+    assert(runs.count == 1);
+    runs.stop = 0;
+
+    /* A new epoch */
+    buddy_checkpoint(buddy);
+    runs.count = 0;
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 0);
+
+    /* Writes to live memory are marked by the caller */
+    buddy_mark_dirty(buddy, a + 10, 1);
+    buddy_mark_dirty(buddy, data_buf + 32768, 100);
+    buddy_mark_dirty(buddy, data_buf + 65536 - 10, 100);
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 1);
+    assert((runs.addr[0] == data_buf) && (runs.length[0] == 4096));
+
+    free(data_buf);
+    free(buddy_buf);
+}
+
+void test_buddy_dirty_pages_invalid(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(65536, 64));
+    unsigned char *data_buf = malloc(65536);
+    struct buddy_dirty_runs runs = {0};
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 65536, 64);
+    assert(buddy_malloc(buddy, 65536) == data_buf);
+    buddy_checkpoint(buddy);
+    buddy_mark_dirty(NULL, data_buf, 1);
+    buddy_mark_dirty(buddy, NULL, 1);
+    buddy_mark_dirty(buddy, data_buf, 0);
+    buddy_mark_dirty(buddy, data_buf - 1, 1);
+    buddy_mark_dirty(buddy, data_buf + 65536, 1);
+    buddy_checkpoint(NULL);
+    assert(buddy_walk_dirty(NULL, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(buddy_walk_dirty(buddy, NULL, &runs) == NULL);
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 0);
+    free(data_buf);
+    free(buddy_buf);
+}
+
+void test_buddy_dirty_pages_resize(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(65536, 64));
+    unsigned char *data_buf = malloc(65536);
+    struct buddy_dirty_runs runs = {0};
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 16384, 64);
+    assert(buddy_malloc(buddy, 100) == data_buf);
+    assert(buddy_malloc(buddy, 4096) == data_buf + 4096);
+
+    /* The dirty pages follow the tree */
+    assert(buddy_resize(buddy, 65536) == buddy);
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 1);
+    assert((runs.addr[0] == data_buf) && (runs.length[0] == 8192));
+    assert(buddy_malloc(buddy, 32768) == data_buf + 32768);
+
+    buddy_free(buddy, data_buf + 32768);
+    assert(buddy_resize(buddy, 8192) == buddy);
+    runs.count = 0;
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 1);
+    assert((runs.addr[0] == data_buf) && (runs.length[0] == 8192));
+
+    /* Growing again does not bring back pages that were cut off */
+    buddy_reserve_range(buddy, data_buf, 8192);
+    assert(buddy_resize(buddy, 65536) == buddy);
+    buddy_reserve_range(buddy, data_buf + 8192, 65536 - 8192);
+    runs.count = 0;
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 1);
+    assert((runs.addr[0] == data_buf) && (runs.length[0] == 8192));
+    free(data_buf);
+    free(buddy_buf);
+}
+
+void test_buddy_dirty_pages_recover(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(65536, 64));
+    unsigned char *data_buf = malloc(65536);
+    struct buddy_dirty_runs runs = {0};
+    struct buddy *buddy;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 65536 - 640, 64);
+    assert(buddy_malloc(buddy, 32768) == data_buf);
+    buddy_checkpoint(buddy);
+
+    /* Every live page is taken, the last run ends with a partial page */
+    buddy_recover(buddy);
+    assert(buddy_walk_dirty(buddy, buddy_dirty_runs_cb, &runs) == NULL);
+    assert(runs.count == 2);
+    assert((runs.addr[0] == data_buf) && (runs.length[0] == 32768));
+    assert((runs.addr[1] == data_buf + 61440) && (runs.length[1] == 65536 - 640 - 61440));
+    free(data_buf);
+    free(buddy_buf);
+}
+#else
+#define test_buddy_dirty_pages_walk()
+#define test_buddy_dirty_pages_invalid()
+#define test_buddy_dirty_pages_resize()
+#define test_buddy_dirty_pages_recover()
+#endif /* BUDDY_EXPERIMENTAL_DIRTY_PAGES */
+
+#ifdef BUDDY_EXPERIMENTAL_OP_LOG
+/* Moves the pending records of a log to a flat buffer */
+size_t buddy_log_drain(struct buddy_log *log, unsigned char *out) {
+    size_t length = 0;
+    while (log->tail != log->head) {
+        out[length++] = log->buffer[log->tail % log->capacity];
+        log->tail++;
+    }
+    return length;
+}
+
+/* Checks that two allocators have the same slots */
+void buddy_log_verify(struct buddy *a, struct buddy *b) {
+    unsigned char a_state[256], b_state[256];
+    size_t a_length, b_length;
+    a_length = buddy_serialize(a, a_state, sizeof(a_state));
+    b_length = buddy_serialize(b, b_state, sizeof(b_state));
+    assert(a_length && (a_length == b_length));
+    assert(memcmp(a_state, b_state, a_length) == 0);
+}
+
+void test_buddy_op_log_replicate(void) {
+    unsigned char *primary_buf = malloc(buddy_sizeof_alignment(65536, 64));
+    unsigned char *replica_buf = malloc(buddy_sizeof_alignment(65536, 64));
+    unsigned char *primary_data = malloc(65536);
+    unsigned char *replica_data = malloc(65536);
+    unsigned char primary_ring[256], replica_ring[256], records[256], relayed[256];
+    struct buddy_log primary_log = {0}, replica_log = {0};
+    struct buddy *primary, *replica;
+    size_t length, applied;
+    unsigned char *a, *b;
+    START_TEST;
+    primary = buddy_init_alignment(primary_buf, primary_data, 65536, 64);
+    replica = buddy_init_alignment(replica_buf, replica_data, 65536, 64);
+    primary_log.buffer = primary_ring;
+    primary_log.capacity = sizeof(primary_ring);
+    buddy_enable_log(primary, &primary_log);
+    replica_log.buffer = replica_ring;
+    replica_log.capacity = sizeof(replica_ring);
+    buddy_enable_log(replica, &replica_log);
+
+    a = buddy_malloc(primary, 100);
+    b = buddy_calloc(primary, 1, 4096);
+    assert(buddy_malloc(primary, 64) != NULL);
+    a = buddy_realloc(primary, a, 1024, false);
+    buddy_free(primary, b);
+    assert(buddy_safe_free(primary, a, 1024) == BUDDY_SAFE_FREE_SUCCESS);
+    buddy_reserve_range(primary, primary_data + 32768, 8192);
+    buddy_unsafe_release_range(primary, primary_data + 32768, 4096);
+    assert(buddy_resize(primary, 49152) == primary);
+
+    length = buddy_log_drain(&primary_log, records);
+    assert(primary_log.dropped == 0);
+    assert(buddy_apply_log(replica, records, length, &applied) == replica);
+    assert(applied == length);
+    buddy_log_verify(primary, replica);
+
+    /* The replica hands out the same slots */
+    a = buddy_malloc(primary, 2048);
+    assert((unsigned char *) buddy_malloc(replica, 2048) - replica_data == a - primary_data);
+
+    /* A replica logs what it applies, so replicas can be chained */
+    assert(buddy_log_drain(&replica_log, relayed) == length + 2);
+    assert(memcmp(records, relayed, length) == 0);
+
+    /* A clone does not share the log */
+    buddy_log_drain(&primary_log, records);
+    assert(buddy_malloc(buddy_clone(replica_buf, primary, replica_data), 64) != NULL);
+    assert(primary_log.head == primary_log.tail);
+
+    /* Disabling the log */
+    buddy_enable_log(primary, NULL);
+    buddy_free(primary, a);
+    assert(primary_log.head == primary_log.tail);
+    free(replica_data);
+    free(primary_data);
+    free(replica_buf);
+    free(primary_buf);
+}
+
+void test_buddy_op_log_ring(void) {
+    unsigned char *primary_buf = malloc(buddy_sizeof_alignment(65536, 64));
+    unsigned char *replica_buf = malloc(buddy_sizeof_alignment(65536, 64));
+    unsigned char *primary_data = malloc(65536);
+    unsigned char *replica_data = malloc(65536);
+    unsigned char ring[8], records[8];
+    struct buddy_log log = {0};
+    struct buddy *primary, *replica;
+    size_t length, applied;
+    START_TEST;
+    primary = buddy_init_alignment(primary_buf, primary_data, 65536, 64);
+    replica = buddy_init_alignment(replica_buf, replica_data, 65536, 64);
+    log.buffer = ring;
+    log.capacity = sizeof(ring);
+    buddy_enable_log(primary, &log);
+
+    /* Records wrap around the end of the ring */
+    for (size_t i = 0; i < 16; i++) {
+        buddy_free(primary, buddy_malloc(primary, 64));
+        length = buddy_log_drain(&log, records);
+        assert(buddy_apply_log(replica, records, length, &applied) == replica);
+        assert(applied == length);
+        buddy_log_verify(primary, replica);
+    }
+    assert(log.head > log.capacity);
+    assert(log.dropped == 0);
+
+    /* Records that do not fit are dropped */
+    assert(buddy_malloc(primary, 64) != NULL);
+    buddy_free(primary, buddy_malloc(primary, 64));
+    assert(log.dropped == 1);
+    free(replica_data);
+    free(primary_data);
+    free(replica_buf);
+    free(primary_buf);
+}
+
+void test_buddy_op_log_invalid(void) {
+    unsigned char *buddy_buf = malloc(buddy_sizeof_alignment(65536, 64));
+    unsigned char *data_buf = malloc(65536);
+    unsigned char mark_root[] = {BUDDY_LOG_MARK, 1, BUDDY_LOG_MARK, 1};
+    unsigned char release[] = {BUDDY_LOG_RELEASE, 2, BUDDY_LOG_RELEASE, 1};
+    unsigned char bad_index[] = {BUDDY_LOG_RELEASE, 0};
+    unsigned char reserve[] = {BUDDY_LOG_RESERVE, 0x80, 0x80, 0x04, 1};
+    unsigned char unreserve[] = {BUDDY_LOG_UNRESERVE, 0, 0x81, 0x80, 0x04};
+    unsigned char resize[] = {BUDDY_LOG_RESIZE, 64};
+    unsigned char unknown[] = {0, 0};
+    unsigned char truncated[] = {BUDDY_LOG_MARK, 2, BUDDY_LOG_RESERVE, 0, BUDDY_LOG_MARK, 0x80};
+    struct buddy *buddy;
+    size_t applied;
+    START_TEST;
+    buddy = buddy_init_alignment(buddy_buf, data_buf, 65536, 64);
+    buddy_enable_log(NULL, NULL);
+    assert(buddy_apply_log(NULL, mark_root, sizeof(mark_root), &applied) == NULL);
+    assert(applied == 0);
+    assert(buddy_apply_log(buddy, NULL, 0, &applied) == buddy);
+    assert(applied == 0);
+
+    /* A slot can only be marked when it is free */
+    assert(buddy_apply_log(buddy, mark_root, sizeof(mark_root), &applied) == buddy);
+    assert(applied == 2);
+    assert(buddy_malloc(buddy, 1) == NULL);
+    /* Only a whole slot can be released */
+    assert(buddy_apply_log(buddy, release, sizeof(release), &applied) == buddy);
+    assert(applied == 0);
+    buddy_free(buddy, data_buf);
+    assert(buddy_malloc(buddy, 32768) == data_buf);
+    assert(buddy_malloc(buddy, 32768) == data_buf + 32768);
+    assert(buddy_apply_log(buddy, release + 2, 2, &applied) == buddy);
+    assert(applied == 0);
+    assert(buddy_apply_log(buddy, bad_index, sizeof(bad_index), &applied) == buddy);
+    assert(applied == 0);
+    /* Ranges must be within the arena */
+    assert(buddy_apply_log(buddy, reserve, sizeof(reserve), &applied) == buddy);
+    assert(applied == 0);
+    assert(buddy_apply_log(buddy, unreserve, sizeof(unreserve), &applied) == buddy);
+    assert(applied == 0);
+    /* A resize that cannot be done */
+    assert(buddy_apply_log(buddy, resize, sizeof(resize), &applied) == buddy);
+    assert(applied == 0);
+    assert(buddy_apply_log(buddy, unknown, sizeof(unknown), &applied) == buddy);
+    assert(applied == 0);
+    /* Incomplete records are left for later */
+    assert(buddy_apply_log(buddy, truncated, 1, &applied) == buddy);
+    assert(applied == 0);
+    assert(buddy_apply_log(buddy, truncated + 2, 2, &applied) == buddy);
+    assert(applied == 0);
+    assert(buddy_apply_log(buddy, truncated + 4, 2, &applied) == buddy);
+    assert(applied == 0);
+    free(data_buf);
+    free(buddy_buf);
+}
+
+void test_buddy_op_log_embed(void) {
+    unsigned char *primary_buf = malloc(65536);
+    unsigned char *replica_buf = malloc(65536);
+    unsigned char ring[64], records[64];
+    struct buddy_log log = {0};
+    struct buddy *primary, *replica;
+    size_t length, applied;
+    void *ptr;
+    START_TEST;
+    primary = buddy_embed_alignment(primary_buf, 32768, 64);
+    replica = buddy_embed_alignment(replica_buf, 32768, 64);
+    log.buffer = ring;
+    log.capacity = sizeof(ring);
+    buddy_enable_log(primary, &log);
+    ptr = buddy_malloc(primary, 4096);
+    assert(ptr != NULL);
+    primary = buddy_resize(primary, 65536);
+    assert(primary != NULL);
+
+    /* The replica is moved by the resize */
+    length = buddy_log_drain(&log, records);
+    replica = buddy_apply_log(replica, records, length, &applied);
+    assert(applied == length);
+    assert(replica == buddy_get_embed_at_alignment(replica_buf, 65536, 64));
+    buddy_log_verify(primary, replica);
+
+    /* The log stays enabled after the move */
+    buddy_free(primary, ptr);
+    assert(log.head != log.tail);
+    free(replica_buf);
+    free(primary_buf);
+}
+#else
+#define test_buddy_op_log_replicate()
+#define test_buddy_op_log_ring()
+#define test_buddy_op_log_invalid()
+#define test_buddy_op_log_embed()
+#endif /* BUDDY_EXPERIMENTAL_OP_LOG */
+
 void test_buddy_tree_init(void) {
     unsigned char buddy_tree_buf[4096];
     START_TEST;
@@ -2431,6 +3796,7 @@ int main(void) {
         test_buddy_misalignment();
         test_buddy_embed_misalignment();
         test_buddy_invalid_datasize();
+        test_buddy_metadata_size();
 
         test_buddy_init();
         test_buddy_init_virtual_slots();
@@ -2445,6 +3811,7 @@ int main(void) {
         test_buddy_resize_down_to_virtual();
         test_buddy_resize_down_to_virtual_partial();
         test_buddy_resize_down_within_reserved();
+        test_buddy_resize_down_keeps_allocations();
         test_buddy_resize_down_within_reserved_failure();
         test_buddy_resize_down_at_reserved();
         test_buddy_resize_down_before_reserved();
@@ -2455,6 +3822,7 @@ int main(void) {
         test_buddy_resize_embedded_up_at_reserved();
         test_buddy_resize_embedded_up_after_reserved();
         test_buddy_resize_embedded_down_within_reserved();
+        test_buddy_resize_embedded_down_to_arena_size();
         test_buddy_resize_embedded_down_within_reserved_failure();
         test_buddy_resize_embedded_down_at_reserved();
         test_buddy_resize_embedded_down_before_reserved();
@@ -2496,6 +3864,8 @@ int main(void) {
         test_buddy_safe_free_invalid_free_06();
         test_buddy_safe_free_invalid_free_07();
 
+        test_buddy_usable_size();
+
         test_buddy_demo();
         test_buddy_demo_embedded();
 
@@ -2520,6 +3890,15 @@ int main(void) {
         test_buddy_reallocarray_02();
         test_buddy_reallocarray_03();
 
+        test_buddy_realloc_in_place_invalid();
+        test_buddy_realloc_in_place_grow();
+        test_buddy_realloc_in_place_shrink();
+
+        test_buddy_malloc_sg_invalid();
+        test_buddy_malloc_sg_contiguous();
+        test_buddy_malloc_sg_fragmented();
+        test_buddy_malloc_sg_failure();
+
         test_buddy_embedded_not_enough_memory();
         test_buddy_embedded_null();
         test_buddy_embedded_01();
@@ -2528,6 +3907,13 @@ int main(void) {
 
         test_buddy_embed_at();
 
+        test_buddy_clone();
+        test_buddy_clone_embedded();
+        test_buddy_clone_invalid();
+
+        test_buddy_relative_mode();
+        test_buddy_relative_mode_clone();
+
         test_buddy_mixed_use_01();
         test_buddy_mixed_use_02();
         test_buddy_mixed_use_03();
@@ -2552,6 +3938,10 @@ int main(void) {
         test_buddy_unsafe_release_02();
 
         test_buddy_fragmentation();
+        test_buddy_recover();
+        test_buddy_serialize();
+        test_buddy_serialize_capacity();
+        test_buddy_deserialize_invalid();
 
         test_buddy_is_empty();
         test_buddy_is_full();
@@ -2560,6 +3950,29 @@ int main(void) {
         test_buddy_invalid_slot_alignment();
 
         test_buddy_change_tracking();
+        test_buddy_change_tracking_merge();
+
+        test_buddy_deferred_free_reuse();
+        test_buddy_deferred_free_depths();
+        test_buddy_deferred_free_double_free();
+        test_buddy_deferred_free_batch();
+        test_buddy_deferred_free_queries();
+        test_buddy_zero_tracking_calloc();
+        test_buddy_zero_tracking_handout();
+        test_buddy_zero_tracking_mark_invalid();
+        test_buddy_zero_tracking_resize();
+        test_buddy_two_phase_recover();
+        test_buddy_two_phase_free();
+        test_buddy_two_phase_full();
+        test_buddy_two_phase_move();
+        test_buddy_dirty_pages_walk();
+        test_buddy_dirty_pages_invalid();
+        test_buddy_dirty_pages_resize();
+        test_buddy_dirty_pages_recover();
+        test_buddy_op_log_replicate();
+        test_buddy_op_log_ring();
+        test_buddy_op_log_invalid();
+        test_buddy_op_log_embed();
     }
 
     {